@@ -0,0 +1,73 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+#include "sfbook.hpp"
+
+
+/**
+ * Parse a positive integer option value.
+ * @return  false if value is not an integer of at least 1.
+ */
+static bool parse_count(const std::string& value, int& r_count) {
+    try {
+        size_t end;
+        r_count = std::stoi(value, &end);
+        return end == value.size() && r_count >= 1;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+
+/**
+ * Build opening book from games.
+ * Files ending in .pgn are read as PGN, others as one game of UCI moves per line
+ * (e.g. self play logs), optionally preceded by the result.
+ * Usage: swordfish_bookgen [-p plies] [-m min_games] out.bin input...
+ */
+int main(int argc, char** argv) {
+    std::cerr << "Swordfish book builder v" << VERSION_MAJOR << "." << VERSION_MINOR
+        << "." << VERSION_PATCH << std::endl;
+
+    int plies = 20, min_games = 1;
+    std::vector<std::string> args;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc)
+            valid &= parse_count(argv[++i], plies);
+        else if (arg == "-m" && i + 1 < argc)
+            valid &= parse_count(argv[++i], min_games);
+        else
+            args.push_back(arg);
+    }
+    if (!valid || args.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " [-p plies] [-m min_games] out.bin input..."
+            << std::endl;
+        return 1;
+    }
+
+    Book::Builder builder(plies);
+    for (size_t i = 1; i < args.size(); i++) {
+        std::ifstream fp(args[i]);
+        if (!fp) {
+            std::cerr << "Could not open " << args[i] << std::endl;
+            return 1;
+        }
+        const bool pgn = args[i].size() >= 4 && args[i].substr(args[i].size() - 4) == ".pgn";
+        const int games = pgn ? builder.read_pgn(fp) : builder.read_uci(fp);
+        std::cout << args[i] << ": " << games << " games" << std::endl;
+    }
+
+    const long entries = builder.write(args[0], min_games);
+    if (entries < 0) {
+        std::cerr << "Could not write " << args[0] << std::endl;
+        return 1;
+    }
+    std::cout << args[0] << ": " << entries << " entries" << std::endl;
+    return 0;
+}
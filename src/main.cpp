@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
 
 #include "config.hpp"
+#include "sfbook.hpp"
 #include "sfeval.hpp"
 #include "sfmovegen.hpp"
 #include "sfsearch.hpp"
+#include "sfutils.hpp"
 
 
 int main() {
@@ -15,44 +18,100 @@ int main() {
 
     Position pos;
     pos.setup_std();
+    // Hashes of game positions before pos, for repetition detection.
+    std::vector<ull> history;
 
     Transposition::TPTable tptable;
+    Search::Options options;
+    Search::SearchThread search_thread;
 
-    // UCI loop
+    // UCI loop, keeps reading while the search thread runs.
     while (true) {
         UCICommand cmd(std::cin);
 
+        // Commands that change engine state end a running search first.
+        // So do ttstats, which reads the TP table the search writes to, and bench.
+        const bool changes_state = cmd.mode == "quit" || cmd.mode == "position"
+            || cmd.mode == "ucinewgame" || cmd.mode == "setoption" || cmd.mode == "go"
+            || cmd.mode == "ttstats" || cmd.mode == "bench";
+        if (changes_state || cmd.mode == "stop") {
+            search_thread.stop();
+            search_thread.wait();
+        }
+
         if (cmd.mode == "quit") {
             break;
         } else if (cmd.mode == "d") {
             Ascii::print(std::cout, pos);
             std::cout << "Hash: " << tptable.hash(pos) << std::endl;
+            std::cout << "Book key: " << std::hex << Book::key(pos) << std::dec << std::endl;
         } else if (cmd.mode == "eval") {
-            std::vector<Move> moves;
+            Movegen::MoveList moves;
             ull attacks;
             Movegen::get_legal_moves(pos, moves, attacks);
             int kpos = Bit::first(*pos.relative_bb(pos.turn).mk);
             const int score = Eval::eval(pos, moves.size(), attacks, kpos, 0);
             std::cout << score << " cp (pov current turn)" << std::endl;
+        } else if (cmd.mode == "ttstats") {
+            Search::print_tt_stats(tptable, std::cout);
+        } else if (cmd.mode == "profile") {
+            Profile::print(std::cout);
+        } else if (cmd.mode == "bench") {
+            const int depth = cmd.args.count("depth") ? cmd.args["depth"] : 8;
+            const int threads = cmd.args.count("threads") ? cmd.args["threads"] : 1;
+            const int hash = cmd.args.count("hash") ? cmd.args["hash"] : 16;
+            Search::bench(depth, threads, hash);
+        } else if (cmd.mode == "ponderhit") {
+            search_thread.ponderhit();
         } else if (cmd.mode == "isready") {
-            std::cout << "readyok" << std::endl;
+            uci_send("readyok");
         } else if (cmd.mode == "uci") {
+            std::cout << "id name Swordfish " << VERSION_MAJOR << "." << VERSION_MINOR << "."
+                << VERSION_PATCH << "\n";
+            options.print_uci(std::cout);
             std::cout << "uciok" << std::endl;
+        } else if (cmd.mode == "setoption") {
+            if (!options.set(cmd.name, cmd.value))
+                std::cerr << "Unknown option: " << cmd.name << std::endl;
+            search_thread.clear(options);
         } else if (cmd.mode == "ucinewgame") {
             pos.setup_std();
+            history.clear();
+            search_thread.clear(options);
         } else if (cmd.mode == "position") {
             pos = cmd.pos;
+            history.clear();
+            for (const Position& p: cmd.history)
+                history.push_back(tptable.hash(p));
         } else if (cmd.mode == "go") {
             if (cmd.args.count("perft")) {
                 SearchResult res = Search::perft(pos, cmd.args["perft"]);
                 std::cout << res.uci() << std::endl;
             } else {
-                const int movetime = Search::get_movetime(pos, cmd.args);
-                const int maxdepth = cmd.args.count("depth") ? cmd.args["depth"] : 255;
-                const Move bestmove = Search::search(tptable, pos, maxdepth, movetime);
-                std::cout << "bestmove " << bestmove.uci() << std::endl;
+                Search::Limits limits;
+                limits.infinite = cmd.args.count("infinite");
+                limits.ponder = cmd.args.count("ponder");
+                if (!limits.infinite)
+                    Search::get_time_limits(pos, cmd.args, limits.soft_time, limits.movetime);
+                if (cmd.args.count("depth"))
+                    limits.depth = std::clamp(cmd.args["depth"], 1LL, 255LL);
+                if (cmd.args.count("mate"))
+                    limits.mate = std::clamp(cmd.args["mate"], 0LL, 255LL);
+                if (cmd.args.count("nodes") && cmd.args["nodes"] >= 0)
+                    limits.nodes = cmd.args["nodes"];
+
+                // Book moves are played instantly.
+                Move book_move;
+                const bool use_book = options.own_book && !limits.infinite && !limits.ponder
+                    && limits.mate == 0;
+                if (use_book && Book::probe(pos, options.book_best, book_move)) {
+                    uci_send("info string book move");
+                    uci_send("bestmove " + book_move.uci());
+                    continue;
+                }
 
                 tptable.search_index++;
+                search_thread.start(tptable, pos, history, limits, options);
             }
         }
     }
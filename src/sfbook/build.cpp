@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "sfbook.hpp"
+#include "sfmovegen.hpp"
+
+
+namespace Book {
+
+
+/**
+ * Parse PGN or UCI result token.
+ * @return  false if not a result.
+ */
+static bool parse_result(const std::string& token, int& r_result) {
+    if (token == "1-0") r_result = 1;
+    else if (token == "0-1") r_result = -1;
+    else if (token == "1/2-1/2" || token == "*") r_result = 0;
+    else return false;
+    return true;
+}
+
+/**
+ * Piece type (0 pawn ... 5 king) of SAN letter, or -1.
+ */
+static int san_type(char ch) {
+    switch (ch) {
+        case 'N': return 1;
+        case 'B': return 2;
+        case 'R': return 3;
+        case 'Q': return 4;
+        case 'K': return 5;
+        default: return -1;
+    }
+}
+
+
+bool parse_san(Position& pos, const std::string& san, Move& r_move) {
+    std::string str = san;
+    while (!str.empty() && std::string("+#!?").find(str.back()) != std::string::npos)
+        str.pop_back();
+
+    Movegen::MoveList legal;
+    ull attacks;
+    Movegen::get_legal_moves(pos, legal, attacks);
+
+    // Castling.
+    std::replace(str.begin(), str.end(), '0', 'O');
+    if (str == "O-O" || str == "O-O-O") {
+        const int offset = str == "O-O" ? 2 : -2;
+        for (const Move& move: legal) {
+            const int piece = pos.piece_at(move.from);
+            if ((piece == WK || piece == BK) && move.to - move.from == offset) {
+                r_move = move;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int type = 0;
+    if (!str.empty() && san_type(str[0]) > 0) {
+        type = san_type(str[0]);
+        str.erase(0, 1);
+    }
+
+    int promo = Promo::NONE;
+    if (str.size() >= 2 && san_type(str.back()) > 0) {
+        promo = Ascii::char2promo(std::tolower(str.back()));
+        str.pop_back();
+        if (!str.empty() && str.back() == '=')
+            str.pop_back();
+    }
+
+    str.erase(std::remove(str.begin(), str.end(), 'x'), str.end());
+    if (str.size() < 2)
+        return false;
+    const std::string dest = str.substr(str.size() - 2);
+    if (dest[0] < 'a' || dest[0] > 'h' || dest[1] < '1' || dest[1] > '8')
+        return false;
+    const int to = Ascii::str2square(dest);
+
+    // Disambiguation by file and/or rank.
+    int file = -1, rank = -1;
+    for (char ch: str.substr(0, str.size() - 2)) {
+        if ('a' <= ch && ch <= 'h') file = ch - 'a';
+        else if ('1' <= ch && ch <= '8') rank = ch - '1';
+        else return false;
+    }
+
+    int found = 0;
+    for (const Move& move: legal) {
+        if (move.to != to || move.promo != promo || (pos.piece_at(move.from) - 1) % 6 != type)
+            continue;
+        if ((file != -1 && move.from % 8 != file) || (rank != -1 && move.from / 8 != rank))
+            continue;
+        r_move = move;
+        found++;
+    }
+    return found == 1;
+}
+
+
+Builder::Builder(int max_ply) {
+    this->max_ply = max_ply;
+}
+
+void Builder::add_game(Position pos, const std::vector<Move>& moves, int result) {
+    const int count = std::min((int)moves.size(), max_ply);
+    for (int i = 0; i < count; i++) {
+        const int mover_result = pos.turn ? result : -result;
+        Stats& stats = this->moves[{key(pos), encode_move(pos, moves[i])}];
+        stats.weight += mover_result + 1;
+        stats.games++;
+        pos.push(moves[i]);
+    }
+}
+
+int Builder::read_pgn(std::istream& is) {
+    const std::string text((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+    Position start, pos;
+    start.setup_std();
+    pos = start;
+    std::vector<Move> game;
+    // Set after an illegal move; rest of game is ignored.
+    bool broken = false;
+    int games = 0;
+
+    auto finish = [&](int result) {
+        if (!game.empty()) {
+            add_game(start, game, result);
+            games++;
+        }
+        start.setup_std();
+        pos = start;
+        game.clear();
+        broken = false;
+    };
+
+    size_t i = 0;
+    while (i < text.size()) {
+        const char ch = text[i];
+        if (std::isspace(ch)) {
+            i++;
+        } else if (ch == '[') {
+            // Tag pair; a new game may start without a result.
+            const size_t end = std::min(text.find(']', i), text.size());
+            const std::string tag = text.substr(i + 1, end - i - 1);
+            if (!game.empty())
+                finish(0);
+            if (tag.rfind("FEN ", 0) == 0) {
+                const size_t q1 = tag.find('"'), q2 = tag.rfind('"');
+                if (q1 != std::string::npos && q2 > q1) {
+                    start.setup_fen(tag.substr(q1 + 1, q2 - q1 - 1));
+                    pos = start;
+                }
+            }
+            i = end + 1;
+        } else if (ch == '{') {
+            i = std::min(text.find('}', i), text.size()) + 1;
+        } else if (ch == ';') {
+            i = std::min(text.find('\n', i), text.size()) + 1;
+        } else if (ch == '(') {
+            // Variations may be nested.
+            int level = 0;
+            for (; i < text.size(); i++) {
+                if (text[i] == '(') level++;
+                else if (text[i] == ')' && --level == 0) break;
+            }
+            i++;
+        } else {
+            size_t end = i;
+            while (end < text.size() && !std::isspace(text[end])
+                    && std::string("[]{}();").find(text[end]) == std::string::npos)
+                end++;
+            std::string token = text.substr(i, end - i);
+            i = std::max(end, i + 1);
+
+            int result;
+            if (parse_result(token, result)) {
+                finish(result);
+                continue;
+            }
+            // Move number, e.g. "12." or "12...Nf6".
+            const size_t digits = token.find_first_not_of("0123456789");
+            if (digits == std::string::npos) {
+                token.clear();
+            } else if (digits > 0 && token[digits] == '.') {
+                const size_t move_start = token.find_first_not_of('.', digits);
+                token = move_start == std::string::npos ? "" : token.substr(move_start);
+            }
+            if (token.empty() || token[0] == '$' || broken)
+                continue;
+
+            Move move;
+            if (parse_san(pos, token, move)) {
+                game.push_back(move);
+                pos.push(move);
+            } else {
+                broken = true;
+            }
+        }
+    }
+    finish(0);
+    return games;
+}
+
+int Builder::read_uci(std::istream& is) {
+    int games = 0;
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream iss(line);
+        Position pos;
+        pos.setup_std();
+        std::vector<Move> game;
+        int result = 0;
+
+        std::string token;
+        while (iss >> token) {
+            if (game.empty() && parse_result(token, result))
+                continue;
+            if (token.size() < 4 || token.size() > 5)
+                break;
+
+            Movegen::MoveList legal;
+            ull attacks;
+            Movegen::get_legal_moves(pos, legal, attacks);
+            const Move move(token);
+            if (std::find(legal.begin(), legal.end(), move) == legal.end())
+                break;
+            game.push_back(move);
+            pos.push(move);
+        }
+
+        if (!game.empty()) {
+            Position start;
+            start.setup_std();
+            add_game(start, game, result);
+            games++;
+        }
+    }
+    return games;
+}
+
+long Builder::write(const std::string& path, int min_games) const {
+    struct Entry {
+        ull key;
+        uint16_t move;
+        ull weight;
+    };
+    std::vector<Entry> entries;
+    ull max_weight = 0;
+    for (const auto& [key_move, stats]: moves) {
+        if (stats.games < min_games || stats.weight == 0)
+            continue;
+        entries.push_back({key_move.first, key_move.second, stats.weight});
+        max_weight = std::max(max_weight, stats.weight);
+    }
+
+    // Weights must fit in 16 bits.
+    for (Entry& entry: entries)
+        if (max_weight > 0xffff)
+            entry.weight = std::max(entry.weight * 0xffff / max_weight, (ull)1);
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+    });
+
+    std::ofstream fp(path, std::ios::binary);
+    for (const Entry& entry: entries) {
+        uint8_t data[ENTRY_SIZE] = {};
+        for (int i = 0; i < 8; i++)
+            data[i] = entry.key >> (56 - 8 * i);
+        data[8] = entry.move >> 8;
+        data[9] = entry.move & 255;
+        data[10] = entry.weight >> 8;
+        data[11] = entry.weight & 255;
+        fp.write((const char*)data, ENTRY_SIZE);
+    }
+    fp.close();
+    return fp ? (long)entries.size() : -1;
+}
+
+
+}
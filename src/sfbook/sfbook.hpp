@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sfutils.hpp"
+
+
+/**
+ * Opening book in Polyglot .bin layout: 16 byte big endian entries
+ * (key, move, weight, learn), sorted by key.
+ *
+ * Moves use the Polyglot encoding (to, from, promotion; castling as king takes rook).
+ * Keys follow the Polyglot scheme (piece-square, castling, en passant only if
+ * capturable, white to move) and its Random64 values, so Polyglot books can be used.
+ */
+namespace Book {
+    // Size of one entry in the file.
+    constexpr int ENTRY_SIZE = 16;
+
+    /**
+     * Book key of position.
+     */
+    ull key(const Position& pos);
+
+    /**
+     * Polyglot move encoding.
+     */
+    uint16_t encode_move(const Position& pos, const Move& move);
+
+    /**
+     * Inverse of encode_move(). Not checked for legality.
+     */
+    Move decode_move(const Position& pos, uint16_t move);
+
+    /**
+     * Map book file, replacing the open one. Empty path just closes.
+     * @return  Number of entries, or -1 on error.
+     */
+    long open(const std::string& path);
+
+    /**
+     * Seed the generator that picks weighted random moves, for repeatable games.
+     */
+    void seed(ull value);
+
+    /**
+     * Book move of position.
+     * @param best  Highest weight move, else random in proportion to weight.
+     * @return  false if position is not in book.
+     */
+    bool probe(Position& pos, bool best, Move& r_move);
+
+    /**
+     * Collects moves of games and writes a book.
+     */
+    class Builder {
+    public:
+        /**
+         * @param max_ply  Only the first max_ply moves of each game are used.
+         */
+        Builder(int max_ply);
+
+        /**
+         * Add moves of game from pos.
+         * Weight of each move is 2 for a win and 1 for a draw, for the side that played it.
+         * @param result  1 white won, 0 draw, -1 black won.
+         */
+        void add_game(Position pos, const std::vector<Move>& moves, int result);
+
+        /**
+         * Read PGN games (SAN movetext). Games without a result count as draws.
+         * @return  Number of games read.
+         */
+        int read_pgn(std::istream& is);
+
+        /**
+         * Read one game per line, UCI moves from the start position,
+         * optionally preceded by a result (1-0, 0-1, 1/2-1/2).
+         * @return  Number of games read.
+         */
+        int read_uci(std::istream& is);
+
+        /**
+         * Write book, dropping moves played in fewer than min_games games.
+         * @return  Number of entries written, or -1 on error.
+         */
+        long write(const std::string& path, int min_games) const;
+
+    private:
+        struct Stats {
+            ull weight = 0;
+            int games = 0;
+        };
+
+        int max_ply;
+        std::map<std::pair<ull, uint16_t>, Stats> moves;
+    };
+
+    /**
+     * Legal move from SAN string, e.g. "Nbd7", "exd8=Q+", "O-O".
+     * @return  false if not a legal move.
+     */
+    bool parse_san(Position& pos, const std::string& san, Move& r_move);
+}
@@ -1,82 +1,11 @@
+#include <algorithm>
+
 #include "sfeval.hpp"
 
 
 namespace Eval {
 
 
-// Piece maps generated by copilot
-static constexpr int MAP_PAWN[64] = {
-    0,  0,  0,  0,  0,  0,  0,  0,
-    50, 50, 50, 50, 50, 50, 50, 50,
-    10, 10, 20, 30, 30, 20, 10, 10,
-    5,  5, 10, 25, 25, 10,  5,  5,
-    0,  0,  0, 20, 20,  0,  0,  0,
-    5, -5,-10,  0,  0,-10, -5,  5,
-    5, 10, 10,-20,-20, 10, 10,  5,
-    0,  0,  0,  0,  0,  0,  0,  0
-};
-static constexpr int MAP_KNIGHT[64] = {
-    -50,-40,-30,-30,-30,-30,-40,-50,
-    -40,-20,  0,  0,  0,  0,-20,-40,
-    -30,  0, 10, 15, 15, 10,  0,-30,
-    -30,  5, 15, 20, 20, 15,  5,-30,
-    -30,  0, 15, 20, 20, 15,  0,-30,
-    -30,  5, 10, 15, 15, 10,  5,-30,
-    -40,-20,  0,  5,  5,  0,-20,-40,
-    -50,-40,-30,-30,-30,-30,-40,-50
-};
-static constexpr int MAP_BISHOP[64] = {
-    -20,-10,-10,-10,-10,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5, 10, 10,  5,  0,-10,
-    -10,  5,  5, 10, 10,  5,  5,-10,
-    -10,  0, 10, 10, 10, 10,  0,-10,
-    -10, 10, 10, 10, 10, 10, 10,-10,
-    -10,  5,  0,  0,  0,  0,  5,-10,
-    -20,-10,-10,-10,-10,-10,-10,-20
-};
-static constexpr int MAP_ROOK[64] = {
-    0,  0,  0,  0,  0,  0,  0,  0,
-    5, 10, 10, 10, 10, 10, 10,  5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    0,  0,  0,  5,  5,  0,  0,  0
-};
-static constexpr int MAP_QUEEN[64] = {
-    -20,-10,-10, -5, -5,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5,  5,  5,  5,  0,-10,
-     -5,  0,  5,  5,  5,  5,  0, -5,
-      0,  0,  5,  5,  5,  5,  0, -5,
-    -10,  5,  5,  5,  5,  5,  0,-10,
-    -10,  0,  5,  0,  0,  0,  0,-10,
-    -20,-10,-10, -5, -5,-10,-10,-20
-};
-static constexpr int MAP_KING[64] = {
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -20,-30,-30,-40,-40,-30,-30,-20,
-    -10,-20,-20,-20,-20,-20,-20,-10,
-     20, 20,  0,  0,  0,  0, 20, 20,
-     20, 30, 10,  0,  0, 10, 30, 20
-};
-static constexpr int MAP_KING_EG[64] = {
-    -50,-40,-30,-20,-20,-30,-40,-50,
-    -30,-20,-10,  0,  0,-10,-20,-30,
-    -30,-10, 20, 30, 30, 20,-10,-30,
-    -30,-10, 30, 40, 40, 30,-10,-30,
-    -30,-10, 30, 40, 40, 30,-10,-30,
-    -30,-10, 20, 30, 30, 20,-10,-30,
-    -30,-30,  0,  0,  0,  0,-30,-30,
-    -50,-30,-30,-30,-30,-30,-30,-50
-};
-
-
 /**
  * Checks if the game finished (checkmate, stalemate, draw).
  * @param attacks  Opposite turn's attacks.
@@ -96,90 +25,141 @@ static inline int check_eog(bool turn, int move_count, ull attacks, int kpos, in
     return 123456789;   // No eog constant.
 }
 
-static inline void material(const Position& pos, int& r_white, int& r_black) {
-    r_white = r_black = 0;
-    r_white += Bit::popcnt(pos.wp);
-    r_black += Bit::popcnt(pos.bp);
-    r_white += 3 * Bit::popcnt(pos.wn);
-    r_black += 3 * Bit::popcnt(pos.bn);
-    r_white += 3 * Bit::popcnt(pos.wb);
-    r_black += 3 * Bit::popcnt(pos.bb);
-    r_white += 5 * Bit::popcnt(pos.wr);
-    r_black += 5 * Bit::popcnt(pos.br);
-    r_white += 9 * Bit::popcnt(pos.wq);
-    r_black += 9 * Bit::popcnt(pos.bq);
+// Pawn structure, per pawn. Passed pawns by rank from their side.
+constexpr PST::Score DOUBLED = PST::make_score(-10, -20);
+constexpr PST::Score ISOLATED = PST::make_score(-10, -15);
+constexpr PST::Score BACKWARD = PST::make_score(-8, -10);
+constexpr int PASSED_MG[8] = {0, 5, 10, 15, 25, 40, 60, 0};
+constexpr int PASSED_EG[8] = {0, 10, 20, 35, 60, 90, 130, 0};
+
+// King shelter, per file next to the king: own pawn one or two ranks ahead, or no own pawn.
+constexpr int SHIELD_NEAR = 12, SHIELD_FAR = 6, SHIELD_OPEN = -8;
+
+constexpr ull RANK_2 = 0xff00ULL, RANK_3 = 0xff0000ULL;
+
+
+static inline ull north_fill(ull b) {
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+    return b;
+}
+
+static inline ull south_fill(ull b) {
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return b;
+}
+
+/**
+ * Squares on the files left and right of b's squares.
+ */
+static inline ull sides(ull b) {
+    return ((b & ~FILES[7]) << 1) | ((b & ~FILES[0]) >> 1);
 }
 
 /**
- * Opening and middlegame policy.
+ * Pawn terms of one side, with the board oriented so that its pawns move north.
+ * @param r_shield  King shelter with the king on each file.
  */
-static inline int piece_map(const Position& pos, int phase) {
-    int pawns, knights, bishops, rooks, queens, kings;
-    pawns = knights = bishops = rooks = queens = kings = 0;
-
-    for (int i = 0; i < 64; i++) {
-        const int piece = pos.piece_at(i);
-        if (piece == EMPTY)
-            continue;
-
-        const int sq = piece <= WK ? 63-i : i;  // Piece maps are reversed.
-        const int mult = piece <= WK ? 1 : -1;
-        switch (piece) {
-            case WP: case BP: pawns += mult * MAP_PAWN[sq]; break;
-            case WN: case BN: knights += mult * MAP_KNIGHT[sq]; break;
-            case WB: case BB: bishops += mult * MAP_BISHOP[sq]; break;
-            case WR: case BR: rooks += mult * MAP_ROOK[sq]; break;
-            case WQ: case BQ: queens += mult * MAP_QUEEN[sq]; break;
-            case WK: case BK:
-                kings += mult * ((100-phase) * MAP_KING[sq]
-                                 + phase * MAP_KING_EG[sq]) / 100;
-                break;
+static PST::Score pawn_terms(ull us, ull them, int8_t r_shield[8]) {
+    // Has an own pawn behind it on the file.
+    const ull doubled = us & north_fill(us << 8);
+    const ull isolated = us & ~sides(north_fill(us) | south_fill(us));
+    // No pawn on a neighbor file level or behind to defend it, and its stop square is attacked.
+    const ull them_attacks = sides(them) >> 8;
+    const ull backward = us & ~isolated & ~sides(north_fill(us)) & (them_attacks >> 8);
+    // No enemy pawn ahead on its or a neighbor file, and no own pawn ahead.
+    const ull passed = us & ~south_fill((them | sides(them)) >> 8) & ~south_fill(us >> 8);
+
+    PST::Score score = DOUBLED * Bit::popcnt(doubled)
+        + ISOLATED * Bit::popcnt(isolated)
+        + BACKWARD * Bit::popcnt(backward);
+    for (ull b = passed; b; ) {
+        const int rank = Bit::pop_lsb(b) / 8;
+        score += PST::make_score(PASSED_MG[rank], PASSED_EG[rank]);
+    }
+
+    for (int file = 0; file < 8; file++) {
+        int shield = 0;
+        for (int x = std::max(file - 1, 0); x <= std::min(file + 1, 7); x++) {
+            if (us & FILES[x] & RANK_2)
+                shield += SHIELD_NEAR;
+            else if (us & FILES[x] & RANK_3)
+                shield += SHIELD_FAR;
+            else if (!(us & FILES[x]))
+                shield += SHIELD_OPEN;
         }
+        r_shield[file] = shield;
     }
+    return score;
+}
 
-    return (
-        1.3 * pawns +
-        0.8 * knights +
-        0.9 * bishops +
-        1.2 * rooks +
-        1.3 * queens +
-        1 * kings
-    );
+/**
+ * Pawn terms of both sides. Black's are computed on the flipped board.
+ */
+static PawnEntry pawn_entry(ull key, ull wp, ull bp) {
+    PawnEntry entry;
+    entry.key = key;
+    entry.score = pawn_terms(wp, bp, entry.shield[0])
+        - pawn_terms(__builtin_bswap64(bp), __builtin_bswap64(wp), entry.shield[1]);
+    return entry;
 }
 
-static inline int pawn_structure(ull wp, ull bp) {
-    // Stacked pawns.
-    int w_stacked = 0, b_stacked = 0;
-    for (int x = 0; x < 8; x++) {
-        int w_count = Bit::popcnt(wp & FILES[x]),
-            b_count = Bit::popcnt(bp & FILES[x]);
-        if (w_count > 0)
-            w_stacked += w_count - 1;
-        if (b_count > 0)
-            b_stacked += b_count - 1;
-    }
 
-    return (
-        (b_stacked - w_stacked)
-    );
+PawnTable::PawnTable(int size) {
+    table.resize(size);
+    clear();
+}
+
+void PawnTable::clear() {
+    // Filled with the entry of no pawns, whose key is 0.
+    std::fill(table.begin(), table.end(), pawn_entry(0, 0, 0));
+}
+
+const PawnEntry& PawnTable::probe(const Position& pos) {
+    // Size is a power of two.
+    PawnEntry& entry = table[pos.pawn_key & (table.size() - 1)];
+    if (entry.key != pos.pawn_key)
+        entry = pawn_entry(pos.pawn_key, pos.wp, pos.bp);
+    return entry;
 }
 
+
 int eval(const Position& pos, int move_count, ull attacks, int kpos, int mydepth) {
     const int eog = check_eog(pos.turn, move_count, attacks, kpos, mydepth);
     if (eog != 123456789)
         return eog;
 
-    int mat_w, mat_b;
-    material(pos, mat_w, mat_b);
-    int mat_total = mat_w + mat_b;
-    int mat_score = 100 * (mat_w-mat_b);
+    return eval(pos);
+}
+
+/**
+ * Tapered eval of the running sums and pawn terms.
+ */
+static inline int eval(const Position& pos, const PawnEntry& pawns) {
+    PST::Score score = pos.psq + pawns.score;
+
+    // King shelter only counts while the king is on its first two ranks.
+    const int wk = Bit::lsb(pos.wk), bk = Bit::lsb(pos.bk);
+    if (wk < 16)
+        score += PST::make_score(pawns.shield[0][wk % 8], 0);
+    if (bk >= 48)
+        score -= PST::make_score(pawns.shield[1][bk % 8], 0);
+
+    const int phase = std::min(std::max(-5*pos.phase_material + 250, 0), 100);
+    return ((100-phase) * PST::mg_value(score) + phase * PST::eg_value(score)) / 100;
+}
 
-    const int phase = std::min(std::max(-5*mat_total + 250, 0), 100);
-    const int pm = piece_map(pos, phase);
-    //const int pawns = pawn_structure(pos.wp, pos.bp);
+int eval(const Position& pos) {
+    PROFILE_SCOPE(EVAL);
+    return eval(pos, pawn_entry(pos.pawn_key, pos.wp, pos.bp));
+}
 
-    const int score = mat_score + 0.4*pm;// + pawns;
-    return score;
+int eval(const Position& pos, PawnTable& pawns) {
+    PROFILE_SCOPE(EVAL);
+    return eval(pos, pawns.probe(pos));
 }
 
 
@@ -1,11 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
 #include "sfutils.hpp"
 
 
 namespace Eval {
     constexpr int MATE_SCORE = 1e6;
 
+    // Entries of a PawnTable.
+    constexpr int PAWN_TABLE_SIZE = 1 << 14;
+
+    /**
+     * Pawn structure terms of one pawn configuration, which depend on nothing else.
+     */
+    struct PawnEntry {
+        // Position::pawn_key.
+        ull key;
+        // Doubled, isolated, backward and passed pawns, white minus black.
+        PST::Score score;
+        // King shelter (midgame) of each side (0 white, 1 black) with its king on each file,
+        // from the pawns in front of it and open files next to it.
+        int8_t shield[2][8];
+    };
+
+    /**
+     * Cache of pawn structure terms, keyed by pawn key.
+     * Pawn structures repeat throughout a search, so almost every probe hits.
+     * Not thread safe: each search thread has its own, kept between searches.
+     */
+    class PawnTable {
+    public:
+        PawnTable(int size = PAWN_TABLE_SIZE);
+
+        /**
+         * Empty all entries.
+         */
+        void clear();
+
+        /**
+         * Entry of pos's pawns, computed on a miss.
+         */
+        const PawnEntry& probe(const Position& pos);
+
+    private:
+        std::vector<PawnEntry> table;
+    };
+
     /**
      * Evaluation in centipawns from current turn's pov.
      */
     int eval(const Position& pos, int move_count, ull attacks, int kpos, int mydepth);
+
+    /**
+     * Same as above, but assumes the game is not over (caller handles mate and stalemate).
+     */
+    int eval(const Position& pos);
+
+    /**
+     * Same as above, looking up pawn structure in pawns.
+     */
+    int eval(const Position& pos, PawnTable& pawns);
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "sfmovegen.hpp"
@@ -51,6 +52,7 @@ static inline ull attacks_sliding(int x, int y, const int offsets[4][2], ull all
 }
 
 void board_info(bool turn, const RelativeBB& relbb, ull& r_attacked, ull& r_checkers, ull& r_pinned) {
+    PROFILE_SCOPE(BOARD_INFO);
     r_attacked = r_checkers = r_pinned = 0;
 
     const ull t_pieces_nok = relbb.t_pieces & ~*relbb.tk;
@@ -107,7 +109,7 @@ void board_info(bool turn, const RelativeBB& relbb, ull& r_attacked, ull& r_chec
  * if (Bit::get(mask, to)): add_move; return true;
  * else: return false;
  */
-static inline bool add_move(int from, int to, ull mask, std::vector<Move>& r_moves) {
+static inline bool add_move(int from, int to, ull mask, MoveList& r_moves) {
     if (Bit::get(mask, to)) {
         r_moves.push_back(Move(from, to));
         return true;
@@ -118,7 +120,7 @@ static inline bool add_move(int from, int to, ull mask, std::vector<Move>& r_mov
 /**
  * Adds promo moves if promo.
  */
-static inline bool add_pawn_move(int from, int to, ull mask, bool turn, std::vector<Move>& r_moves) {
+static inline bool add_pawn_move(int from, int to, ull mask, bool turn, MoveList& r_moves) {
     if (!Bit::get(mask, to))
         return false;
 
@@ -137,7 +139,7 @@ static inline bool add_pawn_move(int from, int to, ull mask, bool turn, std::vec
 }
 
 static inline void get_king_moves(const RelativeBB& relbb, int kx, int ky, ull mask,
-        std::vector<Move>& r_moves) {
+        MoveList& r_moves) {
     const int start = square(kx, ky);
     for (int i = 0; i < 8; i++) {
         const int x = kx + KING_OFFSETS[i][0], y = ky + KING_OFFSETS[i][1];
@@ -149,7 +151,7 @@ static inline void get_king_moves(const RelativeBB& relbb, int kx, int ky, ull m
 }
 
 static inline void get_pawn_moves(const RelativeBB& relbb, int x, int y, bool turn, int kpos,
-        ull mask, const int ep_square, std::vector<Move>& r_moves) {
+        ull mask, const int ep_square, MoveList& r_moves) {
     const int start = square(x, y);
     const int pawn_dir = turn ? 1 : -1;
     const int one_sq_dest = start + 8*pawn_dir;
@@ -185,7 +187,7 @@ static inline void get_pawn_moves(const RelativeBB& relbb, int x, int y, bool tu
 }
 
 static inline void get_knight_moves(const RelativeBB& relbb, int x, int y, ull mask,
-        std::vector<Move>& r_moves) {
+        MoveList& r_moves) {
     const int start = square(x, y);
     for (int i = 0; i < 8; i++) {
         const int nx = x + KNIGHT_OFFSETS[i][0], ny = y + KNIGHT_OFFSETS[i][1];
@@ -197,7 +199,7 @@ static inline void get_knight_moves(const RelativeBB& relbb, int x, int y, ull m
 }
 
 static inline void get_sliding_moves(const RelativeBB& relbb, int x, int y, const int offsets[4][2],
-        ull mask, std::vector<Move>& r_moves) {
+        ull mask, MoveList& r_moves) {
     const int start = square(x, y);
 
     for (int i = 0; i < 4; i++) {
@@ -218,7 +220,8 @@ static inline void get_sliding_moves(const RelativeBB& relbb, int x, int y, cons
     }
 }
 
-void get_legal_moves(Position& pos, std::vector<Move>& r_moves, ull& r_attacks) {
+void get_legal_moves(Position& pos, MoveList& r_moves, ull& r_attacks) {
+    PROFILE_SCOPE(MOVEGEN);
     RelativeBB relbb = pos.relative_bb(pos.turn);
     ull attacked, checkers, pinned;
     board_info(!pos.turn, relbb.swap_sides(), attacked, checkers, pinned);
@@ -317,4 +320,120 @@ void get_legal_moves(Position& pos, std::vector<Move>& r_moves, ull& r_attacks)
 }
 
 
+bool is_legal(const Position& pos, const Move& move) {
+    if (move.is_null())
+        return false;
+
+    Position after = pos;
+    const RelativeBB relbb = after.relative_bb(pos.turn);
+    if (!Bit::get(relbb.m_pieces, move.from) || Bit::get(relbb.m_pieces, move.to))
+        return false;
+
+    if (Bit::get(*relbb.mp, move.from)) {
+        const int dir = pos.turn ? 8 : -8;
+        const int y = move.to / 8;
+        const bool last_rank = pos.turn ? y == 7 : y == 0;
+        if (last_rank != (move.promo != Promo::NONE))
+            return false;
+
+        if (move.to == move.from + dir) {
+            if (Bit::get(relbb.a_pieces, move.to))
+                return false;
+        } else if (move.to == move.from + 2*dir) {
+            const int start_y = pos.turn ? 1 : 6;
+            if (move.from / 8 != start_y || Bit::get(relbb.a_pieces, move.from + dir)
+                    || Bit::get(relbb.a_pieces, move.to))
+                return false;
+        } else if (Bit::get(ATTACKS_PAWN[pos.turn][move.from], move.to)) {
+            if (!Bit::get(relbb.t_pieces, move.to) && move.to != pos.ep)
+                return false;
+        } else {
+            return false;
+        }
+    } else {
+        if (move.promo != Promo::NONE)
+            return false;
+
+        ull attacks = 0;
+        if (Bit::get(*relbb.mn, move.from))
+            attacks = ATTACKS_KNIGHT[move.from];
+        else if (Bit::get(*relbb.mk, move.from))
+            attacks = ATTACKS_KING[move.from];
+        if (Bit::get(*relbb.mb, move.from) || Bit::get(*relbb.mq, move.from))
+            attacks |= attacks_bishop(move.from, relbb.a_pieces);
+        if (Bit::get(*relbb.mr, move.from) || Bit::get(*relbb.mq, move.from))
+            attacks |= attacks_rook(move.from, relbb.a_pieces);
+        if (!Bit::get(attacks, move.to))
+            return false;
+    }
+
+    // Own king must not be attacked afterwards.
+    after.push(move);
+    const RelativeBB after_bb = after.relative_bb(pos.turn);
+    const int kpos = Bit::first(*after_bb.mk);
+    return !(attackers(after, kpos, after_bb.a_pieces) & after_bb.t_pieces);
+}
+
+
+int see(const Position& pos, const Move& move) {
+    const ull* const boards[13] = {nullptr, &pos.wp, &pos.wn, &pos.wb, &pos.wr, &pos.wq, &pos.wk,
+        &pos.bp, &pos.bn, &pos.bb, &pos.br, &pos.bq, &pos.bk};
+    const ull white = pos.wp | pos.wn | pos.wb | pos.wr | pos.wq | pos.wk;
+    const ull black = pos.bp | pos.bn | pos.bb | pos.br | pos.bq | pos.bk;
+    const ull diag = pos.wb | pos.bb | pos.wq | pos.bq;
+    const ull ortho = pos.wr | pos.br | pos.wq | pos.bq;
+    const int to = move.to;
+    ull occ = white | black;
+
+    // gain[d]: material of the side making capture d if the sequence stops after it.
+    int gain[32];
+    int d = 0;
+    const int attacker = pos.piece_at(move.from);
+    gain[0] = PIECE_VALUE[pos.piece_at(to)];
+    int on_square = PIECE_VALUE[attacker];
+    if (to == pos.ep && (attacker == WP || attacker == BP)) {
+        gain[0] = PIECE_VALUE[WP];
+        occ = Bit::unset(occ, to + (pos.turn ? -8 : 8));
+    }
+    if (move.promo != Promo::NONE) {
+        constexpr int promo_piece[5] = {EMPTY, WN, WB, WR, WQ};
+        on_square = PIECE_VALUE[promo_piece[move.promo]];
+        gain[0] += on_square - PIECE_VALUE[WP];
+    }
+    occ = Bit::unset(occ, move.from);
+    ull attacks = attackers(pos, to, occ) & occ;
+
+    bool side = !pos.turn;
+    while (d < 31) {
+        const ull mine = attacks & (side ? white : black);
+        if (!mine)
+            break;
+
+        // Least valuable attacker.
+        const int first = side ? WP : BP;
+        int piece = first;
+        while (!(mine & *boards[piece]))
+            piece++;
+        // King can't capture onto a defended square.
+        if (piece == first + 5 && (attacks & (side ? black : white)))
+            break;
+
+        d++;
+        gain[d] = on_square - gain[d-1];
+        on_square = PIECE_VALUE[piece];
+        occ = Bit::unset(occ, Bit::lsb(mine & *boards[piece]));
+        attacks |= (attacks_bishop(to, occ) & diag) | (attacks_rook(to, occ) & ortho);
+        attacks &= occ;
+        side = !side;
+    }
+
+    // Each side captures only if it gains from doing so.
+    while (d > 0) {
+        gain[d-1] = -std::max(-gain[d-1], gain[d]);
+        d--;
+    }
+    return gain[0];
+}
+
+
 }  // namespace Movegen
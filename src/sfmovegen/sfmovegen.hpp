@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vector>
+#include <array>
 
 #include "sfutils.hpp"
 
@@ -9,12 +9,167 @@
  * Generate legal moves of a chess position.
  */
 namespace Movegen {
-    const int KING_OFFSETS[8][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0},
+    // More than the maximum number of legal moves in any position.
+    constexpr int MAX_MOVES = 256;
+
+    // Material values used for exchanges and capture ordering, indexed by piece code.
+    constexpr int PIECE_VALUE[13] = {0, 100, 320, 330, 500, 900, 20000,
+        100, 320, 330, 500, 900, 20000};
+
+    /**
+     * Fixed capacity list of moves, so generating moves never allocates.
+     */
+    class MoveList {
+    public:
+        MoveList() {
+            count = 0;
+        }
+
+        inline void push_back(const Move& move) {
+            moves[count++] = move;
+        }
+
+        inline int size() const {
+            return count;
+        }
+
+        inline void clear() {
+            count = 0;
+        }
+
+        inline Move& operator[](int i) {
+            return moves[i];
+        }
+
+        inline const Move& operator[](int i) const {
+            return moves[i];
+        }
+
+        inline const Move* begin() const {
+            return moves;
+        }
+
+        inline const Move* end() const {
+            return moves + count;
+        }
+
+    private:
+        Move moves[MAX_MOVES];
+        int count;
+    };
+
+    constexpr int KING_OFFSETS[8][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0},
         {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
-    const int KNIGHT_OFFSETS[8][2] = {{-1, 2}, {1, 2}, {-1, -2}, {1, -2},
+    constexpr int KNIGHT_OFFSETS[8][2] = {{-1, 2}, {1, 2}, {-1, -2}, {1, -2},
         {-2, 1}, {-2, -1}, {2, 1}, {2, -1}};
-    const int BISHOP_OFFSETS[4][2] = {{-1, -1}, {1, 1}, {1, -1}, {-1, 1}};
-    const int ROOK_OFFSETS[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+    constexpr int BISHOP_OFFSETS[4][2] = {{-1, -1}, {1, 1}, {1, -1}, {-1, 1}};
+    constexpr int ROOK_OFFSETS[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+
+    /**
+     * Ray directions. First four increase the square index, last four decrease it.
+     * Even index is rook direction, odd index is bishop direction.
+     */
+    constexpr int RAY_OFFSETS[8][2] = {{0, 1}, {1, 1}, {1, 0}, {-1, 1},
+        {0, -1}, {-1, -1}, {-1, 0}, {1, -1}};
+
+    /**
+     * Squares reached from each square with the given offsets (knight or king).
+     */
+    constexpr std::array<ull, 64> make_leaper_table(const int offsets[8][2]) {
+        std::array<ull, 64> table {};
+        for (int sq = 0; sq < 64; sq++) {
+            for (int i = 0; i < 8; i++) {
+                const int x = sq % 8 + offsets[i][0], y = sq / 8 + offsets[i][1];
+                if (0 <= x && x < 8 && 0 <= y && y < 8)
+                    table[sq] |= 1ULL << (x + 8*y);
+            }
+        }
+        return table;
+    }
+
+    /**
+     * Squares attacked by a pawn of side on each square.
+     */
+    constexpr std::array<ull, 64> make_pawn_table(bool side) {
+        std::array<ull, 64> table {};
+        const int dy = side ? 1 : -1;
+        for (int sq = 0; sq < 64; sq++) {
+            const int x = sq % 8, y = sq / 8 + dy;
+            if (y < 0 || y > 7)
+                continue;
+            if (x > 0) table[sq] |= 1ULL << (x-1 + 8*y);
+            if (x < 7) table[sq] |= 1ULL << (x+1 + 8*y);
+        }
+        return table;
+    }
+
+    /**
+     * Empty board rays from each square, excluding the square itself.
+     */
+    constexpr std::array<std::array<ull, 64>, 8> make_ray_table() {
+        std::array<std::array<ull, 64>, 8> table {};
+        for (int dir = 0; dir < 8; dir++) {
+            for (int sq = 0; sq < 64; sq++) {
+                int x = sq % 8 + RAY_OFFSETS[dir][0], y = sq / 8 + RAY_OFFSETS[dir][1];
+                while (0 <= x && x < 8 && 0 <= y && y < 8) {
+                    table[dir][sq] |= 1ULL << (x + 8*y);
+                    x += RAY_OFFSETS[dir][0];
+                    y += RAY_OFFSETS[dir][1];
+                }
+            }
+        }
+        return table;
+    }
+
+    constexpr std::array<ull, 64> ATTACKS_KNIGHT = make_leaper_table(KNIGHT_OFFSETS);
+    constexpr std::array<ull, 64> ATTACKS_KING = make_leaper_table(KING_OFFSETS);
+    constexpr std::array<ull, 64> ATTACKS_PAWN[2] = {make_pawn_table(BLACK), make_pawn_table(WHITE)};
+    constexpr std::array<std::array<ull, 64>, 8> RAYS = make_ray_table();
+
+    /**
+     * Squares attacked along one ray, up to and including the first piece in occ.
+     */
+    inline ull ray_attacks(int dir, int sq, ull occ) {
+        ull attacks = RAYS[dir][sq];
+        const ull blockers = attacks & occ;
+        if (blockers) {
+            const int stop = dir < 4 ? Bit::lsb(blockers) : Bit::msb(blockers);
+            attacks ^= RAYS[dir][stop];
+        }
+        return attacks;
+    }
+
+    inline ull attacks_bishop(int sq, ull occ) {
+        return ray_attacks(1, sq, occ) | ray_attacks(3, sq, occ)
+             | ray_attacks(5, sq, occ) | ray_attacks(7, sq, occ);
+    }
+
+    inline ull attacks_rook(int sq, ull occ) {
+        return ray_attacks(0, sq, occ) | ray_attacks(2, sq, occ)
+             | ray_attacks(4, sq, occ) | ray_attacks(6, sq, occ);
+    }
+
+    /**
+     * All pieces of both sides attacking sq, with occ as the occupancy.
+     */
+    inline ull attackers(const Position& pos, int sq, ull occ) {
+        const ull diag = pos.wb | pos.bb | pos.wq | pos.bq;
+        const ull ortho = pos.wr | pos.br | pos.wq | pos.bq;
+        return (ATTACKS_PAWN[BLACK][sq] & pos.wp)
+             | (ATTACKS_PAWN[WHITE][sq] & pos.bp)
+             | (ATTACKS_KNIGHT[sq] & (pos.wn | pos.bn))
+             | (ATTACKS_KING[sq] & (pos.wk | pos.bk))
+             | (attacks_bishop(sq, occ) & diag)
+             | (attacks_rook(sq, occ) & ortho);
+    }
+
+    /**
+     * Whether the side to move is in check.
+     */
+    inline bool in_check(Position& pos) {
+        const RelativeBB relbb = pos.relative_bb(pos.turn);
+        return attackers(pos, Bit::first(*relbb.mk), relbb.a_pieces) & relbb.t_pieces;
+    }
 
     /**
      * Set a sequence of squares.
@@ -60,5 +215,19 @@ namespace Movegen {
      * Appends moves to r_moves
      * @param r_attacks  Other side's attacks.
      */
-    void get_legal_moves(Position& pos, std::vector<Move>& r_moves, ull& r_attacks);
+    void get_legal_moves(Position& pos, MoveList& r_moves, ull& r_attacks);
+
+    /**
+     * Check if a move (e.g. from the transposition table) is legal without generating moves.
+     * Castling is never accepted here; it is found by get_legal_moves.
+     */
+    bool is_legal(const Position& pos, const Move& move);
+
+    /**
+     * Static exchange evaluation: material won by the side to move after all captures
+     * on move.to, each side capturing with its least valuable attacker and free to stop.
+     * Sliders behind other attackers (x-rays) join as the pieces in front are used.
+     * Pins are ignored.
+     */
+    int see(const Position& pos, const Move& move);
 }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sfeval.hpp"
+#include "sfutils.hpp"
+
+
+namespace Search {
+    /**
+     * Direct mapped cache of static evals, keyed by position hash.
+     * Each search thread has its own, kept between searches, so it needs no locking.
+     */
+    class EvalCache {
+    public:
+        /**
+         * @param size_kb  Rounded down to a power of two entries. 0 disables the cache.
+         */
+        EvalCache(int size_kb) {
+            reset(size_kb);
+        }
+
+        /**
+         * Empty the cache, resizing it to size_kb (see constructor).
+         */
+        void reset(int size_kb) {
+            const ull count = (ull)size_kb * 1024 / sizeof(Entry);
+            ull size = 1;
+            while (size * 2 <= count)
+                size *= 2;
+            table.assign(count > 0 ? size : 0, Entry());
+            table.shrink_to_fit();
+            mask = size - 1;
+        }
+
+        /**
+         * Eval::eval(pos, pawns), from the cache if the position was evaluated before.
+         * @param hash  Hash of pos.
+         * @param r_hit  Set to whether the eval was found.
+         */
+        inline int eval(const Position& pos, ull hash, Eval::PawnTable& pawns, bool& r_hit) {
+            r_hit = false;
+            if (table.empty())
+                return Eval::eval(pos, pawns);
+
+            // The index uses the low bits of the hash, so the high bits verify it.
+            Entry& entry = table[hash & mask];
+            const uint32_t check = hash >> 32;
+            if (entry.check == check && entry.eval != EVAL_EMPTY) {
+                r_hit = true;
+                return entry.eval;
+            }
+            entry.check = check;
+            entry.eval = Eval::eval(pos, pawns);
+            return entry.eval;
+        }
+
+    private:
+        // Never a static eval.
+        static constexpr int32_t EVAL_EMPTY = INT32_MIN;
+
+        struct Entry {
+            uint32_t check = 0;
+            int32_t eval = EVAL_EMPTY;
+        };
+
+        std::vector<Entry> table;
+        ull mask;
+    };
+}
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "sfmovegen.hpp"
+#include "sfsearch.hpp"
+#include "sfuci.hpp"
+#include "sfutils.hpp"
+
+
+namespace Search {
+
+
+// Node table capacity. Search gives up when it is full.
+constexpr uint32_t MATE_MAX_NODES = 1 << 21;
+
+// Proof and disproof numbers saturate here, meaning proven impossible.
+constexpr uint32_t PN_INF = 1 << 30;
+
+// Expansions between clock checks.
+constexpr int MATE_TIME_CHECK = 256;
+
+
+/**
+ * Proof number search tree node. Positions aren't stored; they are replayed from the root.
+ * Attacker (side to move at root) nodes are OR nodes, defender nodes are AND nodes.
+ */
+struct MateNode {
+    uint32_t parent;
+    uint32_t first_child;
+    // Proof number: leaves to prove to show a mate. Disproof number: to show there is none.
+    uint32_t pn, dn;
+    Move move;
+    uint8_t child_count;
+    bool expanded;
+};
+
+
+static inline uint32_t pn_add(uint32_t a, uint32_t b) {
+    return std::min(a + b, PN_INF);
+}
+
+
+class MateSearch {
+public:
+    MateSearch(const Position& root_pos, int mate_in) : root_pos(root_pos) {
+        // Reserved, not filled: only pages of used nodes are touched.
+        nodes.reserve(MATE_MAX_NODES);
+        max_ply = 2 * mate_in - 1;
+
+        MateNode root;
+        root.parent = 0;
+        root.child_count = 0;
+        root.expanded = false;
+        root.pn = root.dn = 1;
+        nodes.push_back(root);
+    }
+
+    /**
+     * Expand the most proving node, and update numbers up to the root.
+     * @return  false if out of nodes.
+     */
+    bool step() {
+        Position pos = root_pos;
+        int ply = 0;
+        uint32_t idx = 0;
+
+        // Descend along min pn at OR nodes, min dn at AND nodes.
+        while (nodes[idx].expanded) {
+            const MateNode& node = nodes[idx];
+            const bool or_node = ply % 2 == 0;
+            uint32_t best = node.first_child;
+            for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++) {
+                if (or_node ? nodes[c].pn < nodes[best].pn : nodes[c].dn < nodes[best].dn)
+                    best = c;
+            }
+            idx = best;
+            pos.push(nodes[idx].move);
+            ply++;
+        }
+
+        if (!expand(idx, pos, ply))
+            return false;
+
+        // Update ancestors until numbers stop changing.
+        while (true) {
+            MateNode& node = nodes[idx];
+            const bool or_node = ply % 2 == 0;
+            uint32_t pn = or_node ? PN_INF : 0;
+            uint32_t dn = or_node ? 0 : PN_INF;
+            for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++) {
+                if (or_node) {
+                    pn = std::min(pn, nodes[c].pn);
+                    dn = pn_add(dn, nodes[c].dn);
+                } else {
+                    pn = pn_add(pn, nodes[c].pn);
+                    dn = std::min(dn, nodes[c].dn);
+                }
+            }
+
+            const bool changed = pn != node.pn || dn != node.dn;
+            node.pn = pn;
+            node.dn = dn;
+            if (idx == 0 || !changed)
+                break;
+            idx = node.parent;
+            ply--;
+        }
+        return true;
+    }
+
+    inline const MateNode& root() const {
+        return nodes[0];
+    }
+
+    inline uint32_t size() const {
+        return nodes.size();
+    }
+
+    /**
+     * Plies to mate from a proven node, with best play of both sides.
+     * @param r_best  Child on the mating line (0 if node is a mated leaf).
+     */
+    int proof_length(uint32_t idx, int ply, uint32_t& r_best) const {
+        const MateNode& node = nodes[idx];
+        r_best = 0;
+        if (!node.expanded)
+            return 0;
+
+        // Attacker mates fastest, defender delays longest.
+        const bool or_node = ply % 2 == 0;
+        int best_len = or_node ? 1e9 : -1;
+        for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++) {
+            if (nodes[c].pn != 0)
+                continue;
+            uint32_t grandchild;
+            const int len = 1 + proof_length(c, ply + 1, grandchild);
+            if (or_node ? len < best_len : len > best_len) {
+                best_len = len;
+                r_best = c;
+            }
+        }
+        return best_len;
+    }
+
+    /**
+     * Root child with the lowest proof number.
+     */
+    Move most_promising() const {
+        const MateNode& root = nodes[0];
+        if (!root.expanded || root.child_count == 0)
+            return Move();
+        uint32_t best = root.first_child;
+        for (uint32_t c = root.first_child; c < root.first_child + root.child_count; c++)
+            if (nodes[c].pn < nodes[best].pn)
+                best = c;
+        return nodes[best].move;
+    }
+
+    inline const MateNode& operator[](uint32_t idx) const {
+        return nodes[idx];
+    }
+
+private:
+    const Position& root_pos;
+    std::vector<MateNode> nodes;
+    int max_ply;
+
+    /**
+     * Create children of node, evaluating each immediately.
+     */
+    bool expand(uint32_t idx, Position& pos, int ply) {
+        Movegen::MoveList moves;
+        ull attacks;
+        Movegen::get_legal_moves(pos, moves, attacks);
+        if (nodes.size() + moves.size() > MATE_MAX_NODES)
+            return false;
+
+        const bool or_node = ply % 2 == 0;
+        nodes[idx].first_child = nodes.size();
+        nodes[idx].child_count = moves.size();
+        nodes[idx].expanded = true;
+
+        for (const Move& move: moves) {
+            MateNode child;
+            child.parent = idx;
+            child.move = move;
+            child.child_count = 0;
+            child.expanded = false;
+
+            Position child_pos = pos;
+            child_pos.push(move);
+            Movegen::MoveList replies;
+            ull child_attacks;
+            Movegen::get_legal_moves(child_pos, replies, child_attacks);
+            const bool check = Movegen::in_check(child_pos);
+
+            if (replies.size() == 0) {
+                // Mate is proven only if the defender is mated.
+                const bool mated_defender = or_node && check;
+                child.pn = mated_defender ? 0 : PN_INF;
+                child.dn = mated_defender ? PN_INF : 0;
+            } else if (ply + 1 >= max_ply) {
+                // Out of moves for the attacker.
+                child.pn = PN_INF;
+                child.dn = 0;
+            } else if (or_node) {
+                // Defender to move: fewer replies are easier to refute.
+                // Checks are tried first.
+                child.pn = check ? replies.size() : 2 * replies.size();
+                child.dn = 1;
+            } else {
+                child.pn = 1;
+                child.dn = replies.size();
+            }
+            nodes.push_back(child);
+        }
+        return true;
+    }
+};
+
+
+Move mate_search(Position& pos, const Limits& limits, Signals& signals) {
+    const ull time_start = Time::time();
+    MateSearch ms(pos, std::max(limits.mate, 1));
+
+    bool out_of_nodes = false;
+    for (int i = 0; ms.root().pn != 0 && ms.root().dn != 0; i++) {
+        if (i % MATE_TIME_CHECK == 0) {
+            if (!signals.ponder && Time::elapse(time_start) > limits.movetime)
+                signals.stop = true;
+            if (signals.stop)
+                break;
+        }
+        if (!ms.step()) {
+            out_of_nodes = true;
+            break;
+        }
+    }
+
+    const int elapse = Time::elapse(time_start);
+    SearchResult res;
+    res.data["nodes"] = std::to_string(ms.size());
+    res.data["nps"] = std::to_string(Time::nps(ms.size(), elapse));
+    res.data["time"] = std::to_string(elapse);
+
+    Move best_move;
+    if (ms.root().pn == 0) {
+        uint32_t idx = 0;
+        int ply = 0;
+        const int length = ms.proof_length(0, 0, idx);
+        res.data["depth"] = std::to_string(length);
+        res.data["score mate"] = std::to_string((length + 1) / 2);
+        best_move = ms[idx].move;
+        while (idx != 0) {
+            res.data["pv"] += ms[idx].move.uci() + " ";
+            ms.proof_length(idx, ++ply, idx);
+        }
+        uci_send(res.uci());
+    } else {
+        uci_send(res.uci());
+        if (ms.root().dn == 0)
+            uci_send("info string no mate in " + std::to_string(limits.mate));
+        else
+            uci_send(std::string("info string no mate found")
+                + (out_of_nodes ? " (node table full)" : ""));
+        best_move = ms.most_promising();
+    }
+
+    // No legal moves at root.
+    if (best_move.is_null()) {
+        Movegen::MoveList moves;
+        ull attacks;
+        Movegen::get_legal_moves(pos, moves, attacks);
+        if (moves.size() > 0)
+            best_move = moves[0];
+    }
+
+    // UCI: bestmove of an infinite or ponder search is only sent after stop or ponderhit.
+    while ((limits.infinite || signals.ponder) && !signals.stop)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    return best_move;
+}
+
+
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "movepick.hpp"
+#include "sfmovegen.hpp"
+#include "sfutils.hpp"
+
+
+namespace Search {
+
+
+enum Stage {
+    STAGE_TT,
+    STAGE_GEN,
+    STAGE_GOOD_CAPTURES,
+    STAGE_KILLER1,
+    STAGE_KILLER2,
+    STAGE_COUNTER,
+    STAGE_QUIETS,
+    STAGE_BAD_CAPTURES,
+    STAGE_END,
+};
+
+
+/**
+ * History gravity: keeps value within +-MAX_HISTORY.
+ */
+static inline void update_history(int& value, int bonus) {
+    value += bonus - value * std::abs(bonus) / MAX_HISTORY;
+}
+
+
+void Heuristics::clear() {
+    for (int i = 0; i < 64; i++)
+        for (int j = 0; j < 64; j++)
+            counters[i][j] = Move();
+    std::memset(history, 0, sizeof(history));
+    std::memset(cont_history, 0, sizeof(cont_history));
+}
+
+void Heuristics::update_quiet(const Position& pos, Stack& ss, int depth, const Move& move,
+        const Move& prev, int prev_piece) {
+    if (!(ss.killers[0] == move)) {
+        ss.killers[1] = ss.killers[0];
+        ss.killers[0] = move;
+    }
+    if (!prev.is_null())
+        counters[prev.from][prev.to] = move;
+
+    const int bonus = std::min(depth * depth, 1200);
+    for (int i = 0; i < ss.quiet_count; i++) {
+        const Move& m = ss.quiets[i];
+        const int b = (m == move) ? bonus : -bonus;
+        update_history(history[pos.turn][m.from][m.to], b);
+        if (!prev.is_null())
+            update_history(cont_history[prev_piece][prev.to][pos.piece_at(m.from)][m.to], b);
+    }
+}
+
+
+MovePicker::MovePicker(Position& pos, const Heuristics& heur, Stack& ss, const Move& tt_move,
+        const Move& prev, bool tactical_only)
+        : pos(pos), heur(heur), tt_move(tt_move), prev(prev) {
+    this->tactical_only = tactical_only;
+    killers = ss.killers;
+    moves = ss.moves;
+    stage = STAGE_TT;
+    index = captures_end = quiets_end = 0;
+    bad_start = Movegen::MAX_MOVES;
+    prev_piece = prev.is_null() ? EMPTY : pos.piece_at(prev.to);
+}
+
+bool MovePicker::is_tactical(const Position& pos, const Move& move) {
+    if (move.promo == Promo::QUEEN)
+        return true;
+    const ull t_pieces = pos.turn
+        ? (pos.bp | pos.bn | pos.bb | pos.br | pos.bq | pos.bk)
+        : (pos.wp | pos.wn | pos.wb | pos.wr | pos.wq | pos.wk);
+    if (Bit::get(t_pieces, move.to))
+        return true;
+    return move.to == pos.ep && Bit::get(pos.wp | pos.bp, move.from);
+}
+
+void MovePicker::generate() {
+    Movegen::MoveList legal;
+    ull attacks;
+    Movegen::get_legal_moves(pos, legal, attacks);
+
+    // Captures first, so quiets can be appended after them.
+    for (const Move& move: legal) {
+        if (move == tt_move || !is_tactical(pos, move))
+            continue;
+
+        const int attacker = pos.piece_at(move.from);
+        int victim = pos.piece_at(move.to);
+        if (victim == EMPTY && move.promo != Promo::QUEEN)
+            victim = WP;  // EP
+
+        int victim_value = PIECE_VALUE[victim];
+        if (move.promo == Promo::QUEEN)
+            victim_value += PIECE_VALUE[WQ];
+
+        // MVV-LVA. Captures losing material by SEE go last.
+        // Taking something worth at least the attacker can't lose.
+        const int score = 16 * victim_value - PIECE_VALUE[attacker] / 100;
+        const bool losing = victim_value < PIECE_VALUE[attacker] && Bit::get(attacks, move.to)
+            && Movegen::see(pos, move) < 0;
+        if (!losing)
+            moves[captures_end++] = {move, score};
+        else if (!tactical_only)
+            moves[--bad_start] = {move, score};
+    }
+
+    quiets_end = captures_end;
+    if (tactical_only)
+        return;
+    for (const Move& move: legal)
+        if (!(move == tt_move) && !is_tactical(pos, move))
+            moves[quiets_end++] = {move, 0};
+}
+
+void MovePicker::score_quiets() {
+    for (int i = captures_end; i < quiets_end; i++) {
+        ScoredMove& sm = moves[i];
+        const int piece = pos.piece_at(sm.move.from);
+        sm.score = heur.history[pos.turn][sm.move.from][sm.move.to];
+        if (!prev.is_null())
+            sm.score += heur.cont_history[prev_piece][prev.to][piece][sm.move.to];
+    }
+}
+
+bool MovePicker::take_quiet(const Move& move) {
+    if (move.is_null())
+        return false;
+    for (int i = index; i < quiets_end; i++) {
+        if (moves[i].move == move) {
+            moves[i] = moves[--quiets_end];
+            return true;
+        }
+    }
+    return false;
+}
+
+Move MovePicker::pick_best(int index, int end) {
+    int best = index;
+    for (int i = index + 1; i < end; i++)
+        if (moves[i].score > moves[best].score)
+            best = i;
+    std::swap(moves[index], moves[best]);
+    return moves[index].move;
+}
+
+Move MovePicker::next() {
+    switch (stage) {
+        case STAGE_TT:
+            stage = STAGE_GEN;
+            if (Movegen::is_legal(pos, tt_move) && (!tactical_only
+                    || (is_tactical(pos, tt_move) && Movegen::see(pos, tt_move) >= 0)))
+                return tt_move;
+            tt_move = Move();
+            [[fallthrough]];
+
+        case STAGE_GEN:
+            generate();
+            stage = STAGE_GOOD_CAPTURES;
+            index = 0;
+            [[fallthrough]];
+
+        case STAGE_GOOD_CAPTURES:
+            if (index < captures_end)
+                return pick_best(index++, captures_end);
+            stage = tactical_only ? STAGE_BAD_CAPTURES : STAGE_KILLER1;
+            index = tactical_only ? bad_start : captures_end;
+            return next();
+
+        case STAGE_KILLER1:
+            stage = STAGE_KILLER2;
+            if (take_quiet(killers[0]))
+                return killers[0];
+            [[fallthrough]];
+
+        case STAGE_KILLER2:
+            stage = STAGE_COUNTER;
+            if (take_quiet(killers[1]))
+                return killers[1];
+            [[fallthrough]];
+
+        case STAGE_COUNTER:
+            stage = STAGE_QUIETS;
+            score_quiets();
+            if (!prev.is_null() && take_quiet(heur.counters[prev.from][prev.to]))
+                return heur.counters[prev.from][prev.to];
+            [[fallthrough]];
+
+        case STAGE_QUIETS:
+            if (index < quiets_end)
+                return pick_best(index++, quiets_end);
+            stage = STAGE_BAD_CAPTURES;
+            index = bad_start;
+            [[fallthrough]];
+
+        case STAGE_BAD_CAPTURES:
+            if (index < Movegen::MAX_MOVES)
+                return pick_best(index++, Movegen::MAX_MOVES);
+            stage = STAGE_END;
+            [[fallthrough]];
+
+        default:
+            return Move();
+    }
+}
+
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "sfmovegen.hpp"
+#include "sfutils.hpp"
+#include "stack.hpp"
+
+
+namespace Search {
+    // Bound of history scores.
+    constexpr int MAX_HISTORY = 16384;
+
+    using Movegen::PIECE_VALUE;
+
+    /**
+     * Quiet move ordering tables, updated on beta cutoffs.
+     * Large (several MB): allocate on the heap.
+     */
+    class Heuristics {
+    public:
+        // Refutation of the previous move, indexed by its from and to.
+        Move counters[64][64];
+        // Butterfly history, indexed by turn, from, to.
+        int history[2][64][64];
+        // Continuation history, indexed by previous piece, previous to, piece, to.
+        int cont_history[13][64][13][64];
+
+        Heuristics() {
+            clear();
+        }
+
+        void clear();
+
+        /**
+         * Reward the quiet move that caused a cutoff, and penalize quiets searched before it.
+         * Also updates killers of the node's stack entry.
+         * @param prev  Move that led to this node (null at root).
+         * @param prev_piece  Piece on prev.to.
+         */
+        void update_quiet(const Position& pos, Stack& ss, int depth, const Move& move,
+                const Move& prev, int prev_piece);
+    };
+
+    /**
+     * Search tables of one thread, kept between its searches: quiet move heuristics
+     * and the per-ply stack. Large: allocate on the heap.
+     */
+    struct SearchTables {
+        Heuristics heur;
+        Stack stack[MAX_PLY + 1];
+
+        /**
+         * Forget everything learned, e.g. for a new game.
+         */
+        void clear() {
+            heur.clear();
+            new_search();
+        }
+
+        /**
+         * Reset what only applies to one search: PVs and killers, which are
+         * indexed by ply from the root.
+         */
+        void new_search() {
+            for (Stack& ss: stack) {
+                ss.pv_length = 0;
+                ss.killers[0] = ss.killers[1] = Move();
+            }
+        }
+    };
+
+
+    /**
+     * Returns moves of a position one at a time in a staged order:
+     * TT move (validated without generating), good captures (MVV-LVA), killers, counter move,
+     * quiets (history), bad captures (losing by SEE).
+     * In quiescence (tactical_only), losing captures are not returned at all.
+     */
+    class MovePicker {
+    public:
+        /**
+         * @param ss  Stack entry of this node: killers and move list buffer.
+         * @param tt_move  Best move from transposition (may be null).
+         * @param prev  Move that led to this position (may be null).
+         * @param tactical_only  Only yield captures and queen promotions (quiescence).
+         */
+        MovePicker(Position& pos, const Heuristics& heur, Stack& ss, const Move& tt_move,
+                const Move& prev, bool tactical_only);
+
+        /**
+         * Next move, or null move if exhausted.
+         */
+        Move next();
+
+        /**
+         * Whether move captures something (including EP) or promotes to a queen.
+         */
+        static bool is_tactical(const Position& pos, const Move& move);
+
+    private:
+        Position& pos;
+        const Heuristics& heur;
+        const Move* killers;
+        Move tt_move, prev;
+        int stage, prev_piece;
+        bool tactical_only;
+
+        // Buffer layout: good captures, then quiets, then free space, then bad captures
+        // growing down from the end.
+        ScoredMove* moves;
+        int index, captures_end, quiets_end, bad_start;
+
+        void generate();
+        void score_quiets();
+
+        /**
+         * Remove move from unsearched quiets if present.
+         */
+        bool take_quiet(const Move& move);
+
+        /**
+         * Selection sort step: moves the best of [index, end) to index and returns it.
+         */
+        Move pick_best(int index, int end);
+    };
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+
+#include "sfbook.hpp"
+#include "sfsearch.hpp"
+#include "sftb.hpp"
+#include "sfuci.hpp"
+
+
+namespace Search {
+
+
+/**
+ * Parse UCI check value.
+ */
+static inline bool parse_check(const std::string& value) {
+    return value == "true";
+}
+
+static inline const char* print_check(bool value) {
+    return value ? "true" : "false";
+}
+
+/**
+ * Parse UCI spin value, clamped to [min, max].
+ */
+static inline int parse_spin(const std::string& value, int min, int max) {
+    int x = min;
+    try {
+        x = std::stoi(value);
+    } catch (const std::exception&) {
+    }
+    return std::min(std::max(x, min), max);
+}
+
+
+bool Options::set(const std::string& name, const std::string& value) {
+    if (name == "NullMove") null_move = parse_check(value);
+    else if (name == "LMR") lmr = parse_check(value);
+    else if (name == "ReverseFutility") reverse_futility = parse_check(value);
+    else if (name == "Futility") futility = parse_check(value);
+    else if (name == "LMP") lmp = parse_check(value);
+    else if (name == "DeltaPruning") delta = parse_check(value);
+    else if (name == "Ponder") ponder = parse_check(value);
+    else if (name == "MultiPV") multipv = parse_spin(value, 1, 256);
+    else if (name == "EvalCache") eval_cache_kb = parse_spin(value, 0, 1 << 20);
+    else if (name == "TablebasePath") {
+        tb_path = value;
+        const int count = Tablebase::init(tb_path);
+        uci_send("info string loaded " + std::to_string(count) + " tablebases");
+    }
+#ifdef SF_STATS
+    else if (name == "StatsFile") stats_file = value == "<empty>" ? "" : value;
+#endif
+#ifdef SF_TRACE
+    else if (name == "TraceFile") trace_file = value == "<empty>" ? "" : value;
+#endif
+    else if (name == "OwnBook") own_book = parse_check(value);
+    else if (name == "BookBestMove") book_best = parse_check(value);
+    else if (name == "BookSeed") {
+        book_seed = parse_spin(value, 0, INT32_MAX);
+        Book::seed(book_seed == 0 ? std::random_device{}() : book_seed);
+    }
+    else if (name == "BookFile") {
+        book_path = value == "<empty>" ? "" : value;
+        const long count = Book::open(book_path);
+        if (count < 0)
+            std::cerr << "Could not open book: " << book_path << std::endl;
+        else
+            uci_send("info string loaded " + std::to_string(count) + " book entries");
+    }
+    else return false;
+    return true;
+}
+
+void Options::print_uci(std::ostream& os) const {
+    os << "option name NullMove type check default " << print_check(null_move) << "\n";
+    os << "option name LMR type check default " << print_check(lmr) << "\n";
+    os << "option name ReverseFutility type check default " << print_check(reverse_futility) << "\n";
+    os << "option name Futility type check default " << print_check(futility) << "\n";
+    os << "option name LMP type check default " << print_check(lmp) << "\n";
+    os << "option name DeltaPruning type check default " << print_check(delta) << "\n";
+    os << "option name Ponder type check default " << print_check(ponder) << "\n";
+    os << "option name MultiPV type spin default 1 min 1 max 256\n";
+    os << "option name EvalCache type spin default " << eval_cache_kb << " min 0 max 1048576\n";
+    os << "option name TablebasePath type string default <empty>\n";
+    os << "option name OwnBook type check default " << print_check(own_book) << "\n";
+    os << "option name BookFile type string default <empty>\n";
+    os << "option name BookBestMove type check default " << print_check(book_best) << "\n";
+    os << "option name BookSeed type spin default 0 min 0 max " << INT32_MAX << "\n";
+#ifdef SF_STATS
+    os << "option name StatsFile type string default <empty>\n";
+#endif
+#ifdef SF_TRACE
+    os << "option name TraceFile type string default <empty>\n";
+#endif
+}
+
+
+}
@@ -1,5 +1,3 @@
-#include <vector>
-
 #include "sfmovegen.hpp"
 #include "sfsearch.hpp"
 #include "sfutils.hpp"
@@ -12,14 +10,14 @@ int perft_run(Position& pos, int depth, bool print_each_move = false) {
     if (depth <= 0)
         return 1;
 
-    std::vector<Move> moves;
+    Movegen::MoveList moves;
     ull attacks;
     Movegen::get_legal_moves(pos, moves, attacks);
 
     if (depth == 1) {
         // Print out nodes for each move
         if (print_each_move) {
-            for (int i = 0; i < (int)moves.size(); i++) {
+            for (int i = 0; i < moves.size(); i++) {
                 const Move& move = moves[i];
                 SearchResult res;
                 res.data["currmove"] = move.uci();
@@ -33,7 +31,7 @@ int perft_run(Position& pos, int depth, bool print_each_move = false) {
     }
 
     ull nodes = 0;
-    for (int i = 0; i < (int)moves.size(); i++) {
+    for (int i = 0; i < moves.size(); i++) {
         const Move& move = moves[i];
 
         Position new_pos = pos;
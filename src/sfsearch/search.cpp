@@ -1,271 +1,855 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "movepick.hpp"
 #include "sfeval.hpp"
 #include "sfmovegen.hpp"
+#include "sftb.hpp"
 #include "sfsearch.hpp"
+#include "alloc.hpp"
+#include "evalcache.hpp"
 #include "sfuci.hpp"
 #include "sfutils.hpp"
+#include "stats.hpp"
+#include "timeman.hpp"
+#include "trace.hpp"
 
 using Transposition::TP;
 using Transposition::TPTable;
+using Transposition::BOUND_EXACT;
+using Transposition::BOUND_LOWER;
+using Transposition::BOUND_UPPER;
+using Transposition::EVAL_NONE;
 
 
 namespace Search {
 
 
+// Scores beyond this are mate scores.
+constexpr int MATE_BOUND = Eval::MATE_SCORE - MAX_PLY;
+
+// Nodes between clock checks.
+constexpr ull TIME_CHECK_NODES = 2048;
+
+// Initial half width of aspiration window.
+constexpr int ASPIRATION_DELTA = 25;
+
+// Pruning margins in centipawns, per ply of remaining depth.
+constexpr int RFP_MARGIN = 90;
+constexpr int FUTILITY_MARGIN = 120;
+
+// Quiescence: a capture must be able to bring static eval this close to alpha.
+constexpr int DELTA_MARGIN = 200;
+
+
 /**
- * Alpha beta negamax search that can act like:
- * * Root node: Sets r_eval
- * * Normal search: Sets r_eval
- * * Quiescence search: Evaluates as soon as position is quiet.
+ * Late move reduction amount, indexed by depth and move number.
+ */
+static const auto REDUCTIONS = [] {
+    std::array<std::array<int, 64>, 64> table {};
+    for (int depth = 1; depth < 64; depth++)
+        for (int count = 1; count < 64; count++)
+            table[depth][count] = 0.75 + std::log(depth) * std::log(count) / 2.25;
+    return table;
+}();
+
+
+/**
+ * Mate scores are stored in the TP relative to the node, not the root.
+ */
+static inline int score_to_tp(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static inline int score_from_tp(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+
+/**
+ * State shared by all nodes of one search.
+ */
+struct SearchState {
+    TPTable& tptable;
+    const Options& options;
+    Signals& signals;
+    // Hashes of game positions before the root.
+    const std::vector<ull>& history;
+    ull time_start;
+    int movetime;
+    ull max_nodes;
+
+    // Depth of the current iterative deepening iteration.
+    int root_depth;
+    // Null move is disabled before this ply (during verification search).
+    int nmp_min_ply;
+
+    Heuristics& heur;
+    Stack* stack;
+    EvalCache& eval_cache;
+    Eval::PawnTable& pawn_table;
+
+    // Statistics.
+    ull nodes;
+    int seldepth;
+    ull tbhits;
+    STATS(ull cutoffs, first_move_cutoffs;)
+    STATS(SearchStats stats;)
+    TRACE(TraceWriter trace;)
+
+    // Pondering: clock not running until ponderhit.
+    bool pondering;
+
+    // Root moves skipped (MultiPV lines already found this iteration).
+    Move excluded[Movegen::MAX_MOVES];
+    int excluded_count;
+
+    SearchState(TPTable& tptable, EvalCache& eval_cache, Eval::PawnTable& pawn_table,
+            SearchTables& tables, const Options& options, Signals& signals,
+            const std::vector<ull>& history, ull time_start, int movetime, ull max_nodes)
+            : tptable(tptable), options(options), signals(signals), history(history),
+              heur(tables.heur), stack(tables.stack), eval_cache(eval_cache),
+              pawn_table(pawn_table) {
+        this->time_start = time_start;
+        this->movetime = movetime;
+        this->max_nodes = max_nodes;
+        root_depth = 0;
+        nmp_min_ply = 0;
+        pondering = signals.ponder;
+        excluded_count = 0;
+        nodes = 0;
+        seldepth = 0;
+        STATS(cutoffs = first_move_cutoffs = 0;)
+        tbhits = 0;
+    }
+
+    /**
+     * Whether search should unwind. Checks the clock every TIME_CHECK_NODES nodes.
+     * Time is not checked in the first iteration, so there is always a move.
+     * The node limit is exact, so node limited searches are reproducible.
+     */
+    inline bool should_stop() {
+        if (nodes >= max_nodes)
+            signals.stop = true;
+        if (nodes % TIME_CHECK_NODES == 0 && !check_ponderhit() && root_depth > 1
+                && Time::elapse(time_start) > movetime)
+            signals.stop = true;
+        return signals.stop.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Starts the clock on ponderhit.
+     * @return  Whether still pondering.
+     */
+    inline bool check_ponderhit() {
+        if (pondering && !signals.ponder) {
+            pondering = false;
+            time_start = Time::time();
+        }
+        return pondering;
+    }
+
+    /**
+     * Whether the position at ply occurred before, in search or in the game.
+     * Only the last moves50 plies can repeat it; earlier ones differ by a pawn or piece.
+     * stack[ply].key must be set.
+     */
+    inline bool is_repetition(int ply, int moves50) const {
+        const ull key = stack[ply].key;
+        for (int i = 4; i <= moves50; i += 2) {
+            if (i <= ply) {
+                if (stack[ply-i].key == key)
+                    return true;
+            } else {
+                const int index = (int)history.size() - (i - ply);
+                if (index < 0)
+                    return false;
+                if (history[index] == key)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Static eval relative to pos's turn, through the eval cache.
+     * @param hash  Hash of pos.
+     */
+    inline int evaluate(const Position& pos, ull hash) {
+        bool hit;
+        const int eval = eval_cache.eval(pos, hash, pawn_table, hit);
+        STATS(stats.eval_probes++; stats.eval_hits += hit;)
+        return eval * (pos.turn ? 1 : -1);
+    }
+
+    inline bool is_excluded(const Move& move) const {
+        for (int i = 0; i < excluded_count; i++)
+            if (excluded[i] == move)
+                return true;
+        return false;
+    }
+
+    inline bool stopped() const {
+        return signals.stop.load(std::memory_order_relaxed);
+    }
+};
+
+
+/**
+ * Kinds of search nodes. Each is a separate instantiation of search_node,
+ * compiled with only the logic that node needs.
+ * * Root: Ply 0, full window. Skips MultiPV excluded moves.
+ * * PV: Full window, on the principal variation. Never cut off by TP.
+ * * NonPV: Null window, proving a move is worse. All pruning applies.
+ * * QSearch: Evaluates as soon as position is quiet (either window).
+ */
+enum NodeType {
+    NODE_ROOT,
+    NODE_PV,
+    NODE_NON_PV,
+    NODE_QSEARCH,
+};
+
+
+#ifdef SF_TRACE
+/**
+ * Writes the trace record of a node when it returns, with its final score.
+ */
+struct NodeTrace {
+    SearchState& st;
+    TraceRecord record;
+    const int& score;
+
+    NodeTrace(SearchState& st, int ply, int depth, NodeType node_type, const Move& move,
+            int alpha, int beta, const int& score) : st(st), score(score) {
+        record = TraceRecord();
+        record.ply = ply;
+        record.depth = depth;
+        record.node_type = node_type;
+        record.move = move.from | (move.to << 6) | (move.promo << 12);
+        record.alpha = alpha;
+        record.beta = beta;
+    }
+
+    ~NodeTrace() {
+        if (st.trace.is_open()) {
+            record.score = score;
+            if (st.stopped())
+                record.flags |= TRACE_ABORTED;
+            st.trace.write(record);
+        }
+    }
+};
+#endif
+
+
+/**
+ * Alpha beta negamax search of one node.
  *
  * Some algorithms implemented using pseudocode from https://chessprogramming.org
  *
- * @param maxdepth  Max depth of normal search (quiesce if exceeds).
- * @param mydepth  Depth of this node.
+ * The PV starting from this node is left in st.stack[ply].
+ * If the search is stopped, r_eval is 0 (meaningless) and nothing is written to the TP.
+ *
+ * @param depth  Remaining depth of normal search (quiesce at 0).
+ * @param ply  Distance from root.
  * @param r_eval  Eval of this node relative to position's turn.
- * @param r_pv  PV starting from this node.
- * @param r_maxdepth  Max depth of search.
  */
-static void unified_search(
-        ull time_start, TPTable& tptable, Position& pos, int maxdepth, int mydepth, int movetime,
+template <NodeType NT>
+static void search_node(
+        SearchState& st, Position& pos, int depth, int ply,
         int alpha, int beta,
-        bool is_root, bool is_quiesce,
-        int& r_eval, std::vector<Move>& r_pv, ull& r_nodes, int& r_maxdepth)
+        int& r_eval)
 {
+    constexpr bool is_root = NT == NODE_ROOT;
+    constexpr bool is_quiesce = NT == NODE_QSEARCH;
+    // Node type of children searched with the full window.
+    constexpr NodeType NT_CHILD = is_quiesce ? NODE_QSEARCH
+        : (NT == NODE_NON_PV ? NODE_NON_PV : NODE_PV);
+
+    // Start quie search if remaining depth 0.
+    depth = std::max(depth, 0);
+    if (!is_quiesce && depth == 0) {
+        search_node<NODE_QSEARCH>(st, pos, 0, ply, alpha, beta, r_eval);
+        return;
+    }
+
+    TPTable& tptable = st.tptable;
+    const Options& opts = st.options;
+    Stack& ss = st.stack[ply];
+    // Null at root and after null move.
+    const Move prev_move = ply > 0 ? st.stack[ply-1].move : Move();
     const int alpha_init = alpha;
-    std::vector<Move> legal_moves;
-    ull attacks;
-    int kpos = Bit::first(*pos.relative_bb(pos.turn).mk);
-    Movegen::get_legal_moves(pos, legal_moves, attacks);
-    const int remain_depth = std::max(maxdepth - mydepth, 0);
-    const int static_eval = Eval::eval(pos, legal_moves.size(), attacks, kpos, mydepth)
-        * (pos.turn ? 1 : -1);
-    const ull hash = tptable.hash(pos);
-    TP& tp = *tptable.get(hash);
-    const bool tp_good = (tp.depth != -1 && tp.hash == hash);
+    TRACE(NodeTrace trace(st, ply, depth, NT, prev_move, alpha, beta, r_eval);)
+    const bool pv_node = NT == NODE_ROOT || NT == NODE_PV
+        || (NT == NODE_QSEARCH && beta - alpha > 1);
+    ss.pv_length = 0;
 
     // Set statistic variables.
-    r_nodes++;
-    r_maxdepth = std::max(r_maxdepth, mydepth);
+    st.nodes++;
+    st.seldepth = std::max(st.seldepth, ply);
+    STATS(if (is_quiesce) st.stats.qnodes++; else st.stats.main_nodes++;)
 
-    // End of game.
-    if (legal_moves.size() == 0) {
-        r_eval = static_eval;
+    if (st.should_stop()) {
+        r_eval = 0;
         return;
     }
 
-    // Transposition
-    int tp_skip_ind = -1;
-    if (tp_good) {
-        // Check if beta cutoff.
-        /*
-        if (!is_root && tp.depth >= remain_depth) {
-            if (tp.eval >= beta && tp.alpha < beta) {
-                r_eval = beta;
-                return;
-            }
+    const ull hash = tptable.hash(pos);
+    ss.key = hash;
+
+    // Draw by repetition or fifty move rule.
+    if (!is_root && (pos.moves50 >= 100 || st.is_repetition(ply, pos.moves50))) {
+        r_eval = 0;
+        return;
+    }
+
+    // Probe TP before anything else: if its bound decides this node, it is free.
+    // Not at PV nodes, so the PV stays complete.
+    TP& tp = *tptable.probe(hash);
+    const bool tp_good = (tp.depth != -1 && tp.hash == hash);
+    STATS(st.stats.tt_probes++; st.stats.tt_hits += tp_good;)
+    TRACE(trace.record.flags |= tp_good ? TRACE_TT_HIT : 0;)
+    if (tp_good && !pv_node && tp.depth >= depth) {
+        const int tp_eval = score_from_tp(tp.eval, ply);
+        if (tp.bound == BOUND_EXACT
+                || (tp.bound == BOUND_LOWER && tp_eval >= beta)
+                || (tp.bound == BOUND_UPPER && tp_eval <= alpha)) {
+            STATS(st.stats.tt_cutoffs++;)
+            r_eval = std::min(std::max(tp_eval, alpha), beta);
+            return;
         }
-        */
-
-        // Move ordering.
-        if (!tp.best_move.is_null()) {
-            // Skip matching move already in vector.
-            for (int i = 0; i < (int)legal_moves.size(); i++) {
-                if (legal_moves[i] == tp.best_move) {
-                    tp_skip_ind = i;
-                    break;
-                }
-            }
-            if (tp_skip_ind == -1)
-                throw 1;
+    }
 
-            legal_moves.push_back(tp.best_move);
+    // Exact result from tablebases. Mate distances count from the root.
+    const int tb_pieces = Tablebase::max_pieces();
+    if (!is_root && tb_pieces > 0 && Bit::popcnt(pos.relative_bb(pos.turn).a_pieces) <= tb_pieces) {
+        Tablebase::Result result;
+        if (Tablebase::probe(pos, result)) {
+            st.tbhits++;
+            const int mate = Eval::MATE_SCORE - ply - result.dtm;
+            const int score = result.wdl == 0 ? 0 : (result.wdl > 0 ? mate : -mate);
+            r_eval = std::min(std::max(score, alpha), beta);
+            return;
         }
     }
 
-    // Start quie search if remaining depth 0.
-    if (!is_quiesce && remain_depth == 0) {
-        std::vector<Move> curr_pv;
-        unified_search(
-                time_start, tptable, pos, maxdepth, mydepth + 1, movetime,
-                alpha, beta,
-                false, true,
-                r_eval, curr_pv, r_nodes, r_maxdepth);
+    const bool in_check = Movegen::in_check(pos);
+    if (ply >= MAX_PLY - 1) {
+        r_eval = st.evaluate(pos, hash);
         return;
     }
 
-    // Only used in quiesce.
-    ull t_pieces;
-    if (is_quiesce) {
-        t_pieces = pos.relative_bb(pos.turn).t_pieces;
+    // Static eval is only used by pruning and stand pat, which are off in check and at root.
+    // Reused from TP or the eval cache when this position was evaluated before.
+    int static_eval = EVAL_NONE;
+    if (!in_check && !is_root) {
+        if (tp_good && tp.static_eval != EVAL_NONE)
+            static_eval = tp.static_eval;
+        else
+            static_eval = st.evaluate(pos, hash);
     }
+    ss.static_eval = static_eval;
 
     // Start at static eval in case no captures for quie.
-    if (is_quiesce)
+    // In check, all evasions are searched instead.
+    if (is_quiesce && !in_check) {
         alpha = std::max(alpha, static_eval);
+        if (alpha >= beta) {
+            r_eval = beta;
+            if (tp.search_index != tptable.search_index || tp.depth <= 0)
+                tptable.set(hash, 0, score_to_tp(beta, ply), BOUND_LOWER, Move(), static_eval);
+            return;
+        }
+    }
 
-    Move best_move(0, 0);
-    bool beta_cutoff = false;
-    for (int i = legal_moves.size() - 1; i >= 0; i--) {
-        if (remain_depth > 3 && maxdepth != 1 && Time::elapse(time_start) > movetime)
+    const bool can_prune = !is_root && !is_quiesce && !in_check;
+    const RelativeBB relbb = pos.relative_bb(pos.turn);
+    const int non_pawn = Bit::popcnt(*relbb.mn | *relbb.mb | *relbb.mr | *relbb.mq);
+
+    if (can_prune && std::abs(beta) < MATE_BOUND) {
+        // Reverse futility: static eval is far above beta.
+        if (opts.reverse_futility && !pv_node && depth <= 6
+                && static_eval - RFP_MARGIN * depth >= beta) {
+            r_eval = static_eval;
             return;
-        if (i == tp_skip_ind)
-            continue;
+        }
+
+        // Null move: if passing still fails high, a real move will too.
+        // Not allowed twice in a row, or without pieces (zugzwang).
+        if (opts.null_move && depth >= 3 && static_eval >= beta && non_pawn > 0
+                && !prev_move.is_null() && ply >= st.nmp_min_ply) {
+            const int r = 3 + depth / 4;
+            Position null_pos = pos;
+            null_pos.push_null();
+            ss.move = Move();
+
+            int null_eval;
+            search_node<NODE_NON_PV>(
+                    st, null_pos, depth - 1 - r, ply + 1,
+                    -beta, -beta + 1,
+                    null_eval);
+            null_eval = -null_eval;
+            if (st.stopped()) {
+                r_eval = 0;
+                return;
+            }
+
+            if (null_eval >= beta) {
+                // Verify with a reduced normal search when zugzwang is likely
+                // (a single minor or less) or the cutoff would skip a large subtree.
+                if (non_pawn > 1 && depth < 10) {
+                    r_eval = beta;
+                    return;
+                }
 
-        // Return TP score if current alpha-beta bounds are good enough.
-        // TP alpha-beta should be outside current alpha-beta.
-        if (tp_good) {
-            if (!is_root && tp.depth >= remain_depth) {
-                if (tp.alpha <= alpha && tp.beta >= beta) {
-                    r_eval = std::min(tp.eval, beta);
+                int verify_eval;
+                st.nmp_min_ply = ply + 3 * (depth - r) / 4;
+                search_node<NODE_NON_PV>(
+                        st, pos, depth - r, ply,
+                        beta - 1, beta,
+                        verify_eval);
+                st.nmp_min_ply = 0;
+                if (st.stopped()) {
+                    r_eval = 0;
+                    return;
+                }
+
+                if (verify_eval >= beta) {
+                    r_eval = beta;
                     return;
                 }
             }
         }
+    }
+
+    // Frontier nodes where quiet moves can't raise alpha.
+    const bool futile = opts.futility && can_prune && depth <= 3 && std::abs(alpha) < MATE_BOUND
+        && static_eval + FUTILITY_MARGIN * depth <= alpha;
+    const int lmp_count = 3 + depth * depth;
+
+    const Move tt_move = tp_good ? tp.best_move : Move();
+    MovePicker picker(pos, st.heur, ss, tt_move, prev_move, is_quiesce && !in_check);
+    ss.quiet_count = 0;
+    ss.pv_length = 0;
 
-        const Move& move = legal_moves[i];
+    Move best_move(0, 0);
+    bool beta_cutoff = false;
+    int move_count = 0;
+    Move move;
+    while (!(move = picker.next()).is_null()) {
+        if (is_root && st.is_excluded(move))
+            continue;
+
+        const bool is_quiet = !MovePicker::is_tactical(pos, move);
+
+        // Delta pruning: even winning the captured piece for free doesn't reach alpha.
+        if (opts.delta && is_quiesce && !in_check && move.promo == Promo::NONE) {
+            const int victim = pos.piece_at(move.to);
+            const int gain = PIECE_VALUE[victim == EMPTY ? WP : victim];
+            if (static_eval + gain + DELTA_MARGIN <= alpha)
+                continue;
+        }
 
-        // Check if quiesce and capture move.
-        if (is_quiesce && !Bit::get(t_pieces, move.to))
+        // Late move pruning: skip remaining quiets at shallow depth.
+        if (opts.lmp && can_prune && is_quiet && depth <= 3 && move_count >= lmp_count
+                && alpha > -MATE_BOUND)
             continue;
 
         Position new_pos = pos;
         new_pos.push(move);
+        const bool gives_check = Movegen::in_check(new_pos);
+
+        // Futility pruning.
+        if (futile && is_quiet && !gives_check && move_count > 0)
+            continue;
+
+        move_count++;
+        ss.move = move;
+
+        // Late move reduction: quiet moves late in the ordering are searched shallower
+        // with a null window, and re-searched at full depth if they beat alpha.
+        int reduction = 0;
+        if (opts.lmr && !is_quiesce && depth >= 3 && move_count > (pv_node ? 3 : 1)
+                && is_quiet && !in_check && !gives_check) {
+            reduction = REDUCTIONS[std::min(depth, 63)][std::min(move_count, 63)];
+            if (pv_node)
+                reduction--;
+            reduction = std::min(std::max(reduction, 0), depth - 2);
+        }
 
         // Get eval of new position.
+        // Principal variation search: after the first move, prove each move is worse
+        // with a null window, and re-search with the full window only if it isn't.
         int curr_eval;
-        std::vector<Move> curr_pv;
-        unified_search(
-                time_start, tptable, new_pos, maxdepth, mydepth + 1, movetime,
-                -beta, -alpha,
-                false, is_quiesce,
-                curr_eval, curr_pv, r_nodes, r_maxdepth);
-        curr_eval = -curr_eval;
+        bool full_window = is_quiesce || move_count == 1;
+        if (!full_window) {
+            search_node<NODE_NON_PV>(
+                    st, new_pos, depth - 1 - reduction, ply + 1,
+                    -alpha - 1, -alpha,
+                    curr_eval);
+            curr_eval = -curr_eval;
+
+            // Reduced search beat alpha: verify at full depth.
+            if (reduction > 0 && curr_eval > alpha) {
+                STATS(st.stats.lmr_researches++;)
+                search_node<NODE_NON_PV>(
+                        st, new_pos, depth - 1, ply + 1,
+                        -alpha - 1, -alpha,
+                        curr_eval);
+                curr_eval = -curr_eval;
+            }
+            full_window = pv_node && curr_eval > alpha && curr_eval < beta;
+            STATS(st.stats.pvs_researches += full_window;)
+        }
+        if (full_window) {
+            search_node<NT_CHILD>(
+                    st, new_pos, depth - 1, ply + 1,
+                    -beta, -alpha,
+                    curr_eval);
+            curr_eval = -curr_eval;
+        }
+        if (st.stopped()) {
+            r_eval = 0;
+            return;
+        }
+
+        if (is_quiet && ss.quiet_count < MAX_QUIETS)
+            ss.quiets[ss.quiet_count++] = move;
 
         // Check alpha beta.
         if (curr_eval >= beta) {
             beta_cutoff = true;
-            r_pv.resize(mydepth);
+            best_move = move;
+            STATS(
+                st.cutoffs++;
+                st.first_move_cutoffs += move_count == 1;
+            )
+            TRACE(
+                trace.record.flags |= TRACE_CUTOFF;
+                trace.record.cutoff_index = std::min(move_count, 255);
+            )
+            if (is_quiet && !is_quiesce) {
+                const int prev_piece = prev_move.is_null() ? EMPTY : pos.piece_at(prev_move.to);
+                st.heur.update_quiet(pos, ss, depth, move, prev_move, prev_piece);
+            }
             break;
         }
         if (curr_eval > alpha) {
             alpha = curr_eval;
             best_move = move;
-            r_pv.resize(0);
-            r_pv.push_back(move);
-            r_pv.insert(r_pv.end(), curr_pv.begin(), curr_pv.end());
+            ss.update_pv(move, st.stack[ply+1]);
         }
     }
 
+    // End of game, or quiet position in quiesce.
+    if (move_count == 0) {
+        if (in_check)
+            r_eval = -Eval::MATE_SCORE + ply;
+        else if (!is_quiesce)
+            r_eval = 0;
+        else
+            r_eval = alpha;
+        return;
+    }
+
     // Set returns.
     r_eval = beta_cutoff ? beta : alpha;
 
-    // Write to TP.
-    bool write = false;
-    if (tptable.search_index > tp.search_index)
-        write = true;
-    else if (remain_depth > tp.depth)
-        write = true;
-    else if (remain_depth == tp.depth && r_eval > tp.eval)
-        write = true;
-
-    if (write)
-        tptable.set(hash, remain_depth, r_eval, alpha_init, beta, best_move);
+    // Write to TP. Entries from older searches are always replaced.
+    // Root with excluded moves didn't search the whole position.
+    if (is_root && st.excluded_count > 0)
+        return;
+    const char bound = beta_cutoff ? BOUND_LOWER
+        : (r_eval > alpha_init ? BOUND_EXACT : BOUND_UPPER);
+    if (tp.search_index != tptable.search_index || depth >= tp.depth)
+        tptable.set(hash, depth, score_to_tp(r_eval, ply), bound, best_move, static_eval);
 }
 
 
-Move search(TPTable& tptable, Position& pos, int maxdepth, int movetime) {
-    const ull time_start = Time::time();
-    ull nodes = 0;
+/**
+ * Search a node, choosing the node type from the flags and window.
+ * See search_node.
+ */
+static void unified_search(
+        SearchState& st, Position& pos, int depth, int ply,
+        int alpha, int beta,
+        bool is_root, bool is_quiesce,
+        int& r_eval)
+{
+    if (is_root)
+        search_node<NODE_ROOT>(st, pos, depth, ply, alpha, beta, r_eval);
+    else if (is_quiesce)
+        search_node<NODE_QSEARCH>(st, pos, depth, ply, alpha, beta, r_eval);
+    else if (beta - alpha > 1)
+        search_node<NODE_PV>(st, pos, depth, ply, alpha, beta, r_eval);
+    else
+        search_node<NODE_NON_PV>(st, pos, depth, ply, alpha, beta, r_eval);
+}
+
+
+/**
+ * Best root move by tablebases: fastest win, else a draw, else slowest loss.
+ * @param r_eval  Eval of the best move, relative to root's turn.
+ * @return  false if the root or a move's result isn't in the tablebases.
+ */
+static bool tablebase_root(Position& pos, const Movegen::MoveList& moves, Move& r_best,
+        int& r_eval) {
+    Tablebase::Result result;
+    if (moves.size() == 0 || !Tablebase::probe(pos, result))
+        return false;
+
+    r_eval = -1e9;
+    for (const Move& move: moves) {
+        Position child = pos;
+        child.push(move);
+        if (!Tablebase::probe(child, result))
+            return false;
+        // Child result is relative to the opponent.
+        const int mate = Eval::MATE_SCORE - (result.dtm + 1);
+        const int eval = result.wdl == 0 ? 0 : (result.wdl < 0 ? mate : -mate);
+        if (eval > r_eval) {
+            r_eval = eval;
+            r_best = move;
+        }
+    }
+    return true;
+}
 
-    Move best_move(0, 0);
-    int best_eval = 0;
+
+/**
+ * One root move's line, for MultiPV.
+ */
+struct RootLine {
+    Move pv[MAX_PLY];
+    int pv_length;
+    int eval;
+
+    RootLine() {
+        pv_length = 0;
+        eval = 0;
+    }
+};
+
+
+/**
+ * Root search with an aspiration window around prev_eval, widened until the eval is inside.
+ * Result (if not stopped) is in r_line.
+ */
+static void aspiration_search(SearchState& st, Position& pos, int depth, int prev_eval,
+        RootLine& r_line) {
+    // Full window at low depth and for mate scores.
+    int curr_eval;
+    int delta = ASPIRATION_DELTA;
+    int alpha = -1e9, beta = 1e9;
+    if (depth >= 4 && std::abs(prev_eval) < MATE_BOUND) {
+        alpha = prev_eval - delta;
+        beta = prev_eval + delta;
+    }
+
+    while (true) {
+        unified_search(
+                st, pos, depth, 0,
+                alpha, beta,
+                true, false,
+                curr_eval);
+        if (st.stopped())
+            return;
+
+        // Widen window on the failing side.
+        STATS(if (curr_eval <= alpha || curr_eval >= beta) st.stats.aspiration_researches++;)
+        delta *= 2;
+        if (curr_eval <= alpha) {
+            beta = (alpha + beta) / 2;
+            alpha = delta > 1000 ? -1e9 : curr_eval - delta;
+        } else if (curr_eval >= beta) {
+            beta = delta > 1000 ? 1e9 : curr_eval + delta;
+        } else {
+            break;
+        }
+    }
+
+    const Stack& root = st.stack[0];
+    for (int i = 0; i < root.pv_length; i++)
+        r_line.pv[i] = root.pv[i];
+    r_line.pv_length = root.pv_length;
+    r_line.eval = curr_eval;
+}
+
+
+Move search(TPTable& tptable, EvalCache& eval_cache, Eval::PawnTable& pawn_table,
+        SearchTables& tables, Position& pos, const std::vector<ull>& history,
+        const Limits& limits, const Options& options, Signals& signals, Move& r_ponder_move,
+        SearchInfo& r_info) {
+    const ull time_start = Time::time();
+    int maxdepth = std::min(limits.depth, MAX_PLY - 1);
+    const int movetime = limits.movetime;
+    tables.new_search();
+    SearchState st(tptable, eval_cache, pawn_table, tables, options, signals, history,
+        time_start, movetime, limits.nodes);
+    TimeManager timeman(limits.soft_time, movetime);
+    r_info = SearchInfo();
+    tptable.counters = Transposition::TPCounters();
+    STATS(StatsLog stats_log;)
+    TRACE(
+        if (!options.trace_file.empty() && !st.trace.open(options.trace_file))
+            std::cerr << "Could not write trace: " << options.trace_file << std::endl;
+    )
+
+    // Number of root moves to search fully.
+    Movegen::MoveList root_moves;
+    ull root_attacks;
+    Movegen::get_legal_moves(pos, root_moves, root_attacks);
+    const int multipv = std::max(std::min(options.multipv, root_moves.size()), 1);
+    std::vector<RootLine> lines(multipv);
+
+    Move best_move;
+    Move ponder_move;
+
+    // Tablebase root: the best move is known, no search needed.
+    int tb_eval;
+    if (multipv == 1 && tablebase_root(pos, root_moves, best_move, tb_eval)) {
+        SearchResult res;
+        res.data["depth"] = "1";
+        res.data["pv"] = best_move.uci();
+        res.data["tbhits"] = std::to_string(root_moves.size() + 1);
+        if (tb_eval == 0) {
+            res.data["score cp"] = "0";
+        } else {
+            const int mate_in = (Eval::MATE_SCORE - std::abs(tb_eval) + 1) / 2;
+            res.data["score mate"] = std::to_string(tb_eval > 0 ? mate_in : -mate_in);
+        }
+        if (options.print_info)
+            uci_send(res.uci());
+        maxdepth = 0;
+    }
 
     // Iterative deepening.
     for (int depth = 1; depth <= maxdepth; depth++) {
-        int max_search_depth = 0;
-
-        // Aspiration window.
-        int curr_best_eval;
-        std::vector<Move> curr_pv;
-        int lower, upper;
-        lower = upper = (depth == 1 ? 1e9 : 10);
-
-        while (true) {
-            //const int alpha = best_eval - lower, beta = best_eval + upper;
-            //TODO currently window disabled: we can only write to TP if search doesnt fail.
-            int alpha = -1e9, beta = 1e9;
-            unified_search(
-                    time_start, tptable, pos, depth, 0, movetime,
-                    alpha, beta,
-                    true, false,
-                    curr_best_eval, curr_pv, nodes, max_search_depth);
-
-            // Increase window if fail.
-            if (curr_best_eval <= alpha)
-                lower *= 2;
-            else if (curr_best_eval >= beta)
-                upper *= 2;
-            else
+        st.seldepth = 0;
+        st.root_depth = depth;
+
+        // Each line searches the root without the moves of earlier lines.
+        st.excluded_count = 0;
+        for (int k = 0; k < multipv; k++) {
+            ALLOC_STATS(const Alloc::Counts alloc_start = Alloc::counts();)
+            aspiration_search(st, pos, depth, lines[k].eval, lines[k]);
+            ALLOC_STATS(
+                r_info.tree_allocs += Alloc::counts().allocs - alloc_start.allocs;
+                r_info.tree_bytes += Alloc::counts().bytes - alloc_start.bytes;
+            )
+            if (st.stopped())
                 break;
+            st.excluded[st.excluded_count++] = lines[k].pv[0];
+
+            // First line is a complete search for the best move.
+            if (k == 0) {
+                best_move = lines[0].pv[0];
+                ponder_move = lines[0].pv_length >= 2 ? lines[0].pv[1] : Move();
+            }
         }
-        if (depth > 1 && Time::elapse(time_start) > movetime)
+        // Unfinished iteration is discarded.
+        if (st.stopped())
             break;
 
-        best_eval = curr_best_eval;
-        best_move = curr_pv[0];
+        std::stable_sort(lines.begin(), lines.end(), [](const RootLine& a, const RootLine& b) {
+            return a.eval > b.eval;
+        });
+        best_move = lines[0].pv[0];
+        ponder_move = lines[0].pv_length >= 2 ? lines[0].pv[1] : Move();
 
+        const ull nodes = st.nodes;
         const int elapse = Time::elapse(time_start);
         bool search_done = false;
 
-        SearchResult res;
-        res.data["depth"] = std::to_string(depth);
-        res.data["seldepth"] = std::to_string(max_search_depth);
-        for (const Move& move: curr_pv) {
-            res.data["pv"] += move.uci() + " ";
-        }
-        res.data["nodes"] = std::to_string(nodes);
-        res.data["nps"] = std::to_string(Time::nps(nodes, elapse));
-        res.data["time"] = std::to_string(elapse);
-        res.data["hashfull"] = std::to_string(tptable.get_hashfull());
-        if (abs(best_eval) > 1e5) {
-            int mate_in = (Eval::MATE_SCORE - abs(best_eval) + 1) / 2;
-            res.data["score mate"] = std::to_string(mate_in * (best_eval > 0 ? 1 : -1));
-            if (movetime < 1e9 && mate_in <= depth)
-                search_done = true;
-        } else {
-            res.data["score cp"] = std::to_string(best_eval);
+        for (int k = 0; k < multipv; k++) {
+            const RootLine& line = lines[k];
+            const int eval = line.eval;
+
+            SearchResult res;
+            res.data["depth"] = std::to_string(depth);
+            res.data["seldepth"] = std::to_string(st.seldepth);
+            if (multipv > 1)
+                res.data["multipv"] = std::to_string(k + 1);
+            for (int i = 0; i < line.pv_length; i++) {
+                res.data["pv"] += line.pv[i].uci() + " ";
+            }
+            res.data["nodes"] = std::to_string(nodes);
+            res.data["nps"] = std::to_string(Time::nps(nodes, elapse));
+            res.data["time"] = std::to_string(elapse);
+            res.data["hashfull"] = std::to_string(tptable.get_hashfull());
+            res.data["tbhits"] = std::to_string(st.tbhits);
+            if (abs(eval) > 1e5) {
+                int mate_in = (Eval::MATE_SCORE - abs(eval) + 1) / 2;
+                res.data["score mate"] = std::to_string(mate_in * (eval > 0 ? 1 : -1));
+                if (k == 0 && multipv == 1 && movetime < 1e9 && mate_in <= depth)
+                    search_done = true;
+            } else {
+                res.data["score cp"] = std::to_string(eval);
+            }
+            if (options.print_info)
+                uci_send(res.uci());
         }
-        std::cout << res.uci() << std::endl;
+
+        STATS(
+            stats_log.iteration_done(depth, elapse, nodes, st.cutoffs, st.first_move_cutoffs,
+                st.stats);
+            if (options.print_info)
+                uci_send(stats_log.info());
+        )
 
         if (search_done)
             break;
-    }
-
-    return best_move;
-}
 
+        // Time only counts after ponderhit.
+        timeman.iteration_done(elapse, best_move, lines[0].eval);
+        if (!st.check_ponderhit() && !timeman.should_continue(Time::elapse(st.time_start)))
+            break;
+    }
 
-int get_movetime(const Position& pos, std::map<std::string, int>& args) {
-    if (args.count("movetime"))
-        return args["movetime"];
+    // Stopped during the first iteration.
+    if (best_move.is_null()) {
+        const Stack& root = st.stack[0];
+        if (root.pv_length > 0)
+            best_move = root.pv[0];
+        else if (root_moves.size() > 0)
+            best_move = root_moves[0];
+    }
 
-    int time_left = -1, time_inc = 0;
-    if (pos.turn) {
-        if (args.count("wtime")) time_left = args["wtime"];
-        if (args.count("winc")) time_inc = args["winc"];
-    } else {
-        if (args.count("btime")) time_left = args["btime"];
-        if (args.count("binc")) time_inc = args["binc"];
+    r_info.nodes = st.nodes;
+    TRACE(st.trace.close();)
+
+    // Reply to expect: second PV move, else the TP move after best move.
+    r_ponder_move = ponder_move;
+    if (r_ponder_move.is_null() && !best_move.is_null()) {
+        Position after = pos;
+        after.push(best_move);
+        const ull hash = tptable.hash(after);
+        const TP& tp = *tptable.get(hash);
+        if (tp.depth != -1 && tp.hash == hash && Movegen::is_legal(after, tp.best_move))
+            r_ponder_move = tp.best_move;
     }
 
-    if (time_left == -1)
-        return 1e9;  // Defaults to inf.
+    STATS(
+        if (!options.stats_file.empty()
+                && !stats_log.dump(options.stats_file, pos.get_fen(), tt_stats_json(tptable)))
+            std::cerr << "Could not write stats: " << options.stats_file << std::endl;
+    )
 
-    int moves_left = std::max(50-pos.move, 12);
-    int est_time_left = time_left + moves_left*time_inc;
-    int move_time = est_time_left / moves_left * 0.7;
-    move_time = std::min(move_time, (int)(time_left * 0.6));
-    return move_time;
+    // UCI: bestmove of an infinite or ponder search is only sent after stop or ponderhit.
+    while ((limits.infinite || signals.ponder) && !st.stopped())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    return best_move;
 }
 
 
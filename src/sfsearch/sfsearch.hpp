@@ -1,9 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "evalcache.hpp"
+#include "movepick.hpp"
 #include "transposition.hpp"
 
 #include "sfuci.hpp"
@@ -14,6 +21,97 @@
  * Move generation performance test.
  */
 namespace Search {
+    /**
+     * Search settings, changed with UCI setoption.
+     */
+    struct Options {
+        bool null_move = true;
+        bool lmr = true;
+        bool reverse_futility = true;
+        bool futility = true;
+        bool lmp = true;
+        bool delta = true;
+        // Only tells the GUI that pondering is supported.
+        bool ponder = false;
+        // Number of best root moves reported.
+        int multipv = 1;
+        // Size of each search thread's eval cache (0 to disable).
+        int eval_cache_kb = 64;
+        // Directory of endgame tablebase files, loaded when set.
+        std::string tb_path;
+        // Play moves from opening book file, if one is loaded.
+        bool own_book = false;
+        std::string book_path;
+        // Highest weight book move, else random by weight.
+        bool book_best = false;
+        // Seed of random book moves, 0 for a random seed.
+        int book_seed = 0;
+        // Print info lines while searching. Not a UCI option; off for bench.
+        bool print_info = true;
+#ifdef SF_STATS
+        // File that search statistics are appended to as JSON lines, if set.
+        std::string stats_file;
+#endif
+#ifdef SF_TRACE
+        // File that the search tree of each search is written to, if set.
+        std::string trace_file;
+#endif
+
+        /**
+         * Set option from UCI setoption name and value.
+         * @return  false if name is unknown.
+         */
+        bool set(const std::string& name, const std::string& value);
+
+        /**
+         * Print UCI "option" lines for all options.
+         */
+        void print_uci(std::ostream& os) const;
+    };
+
+    /**
+     * When to stop searching, from UCI go args.
+     */
+    struct Limits {
+        int depth = 255;
+        // Milliseconds. Search is aborted after movetime (hard limit), and no new
+        // iterations are started after around soft_time.
+        int movetime = 1e9;
+        int soft_time = 1e9;
+        // Stop after this many nodes.
+        ull nodes = std::numeric_limits<ull>::max();
+        // Search until stopped, even after reaching depth.
+        bool infinite = false;
+        // Start in ponder mode: like infinite until ponderhit, then movetime applies.
+        bool ponder = false;
+        // Prove a mate in this many moves with mate_search instead (0 for normal search).
+        int mate = 0;
+    };
+
+    /**
+     * Flags set by the UCI thread and read by the search thread.
+     */
+    struct Signals {
+        std::atomic<bool> stop;
+        // Pondering: no time limit. Cleared on ponderhit.
+        std::atomic<bool> ponder;
+
+        Signals() {
+            stop = false;
+            ponder = false;
+        }
+    };
+
+    /**
+     * Results of search() besides the move.
+     */
+    struct SearchInfo {
+        ull nodes = 0;
+        // Heap allocations and bytes during tree search, excluding setup and output
+        // between iterations. Only counted with SF_ALLOC_STATS; should stay 0.
+        ull tree_allocs = 0, tree_bytes = 0;
+    };
+
     /**
      * nodes: Number of leaf nodes.
      */
@@ -22,11 +120,116 @@ namespace Search {
     /**
      * Minimax.
      * pv: Bestmove.
+     * Returns early (with the best move so far) once signals.stop is set.
+     * @param eval_cache, pawn_table  Static evals and pawn structure terms,
+     *     kept between searches by the caller.
+     * @param tables  Move ordering heuristics, also kept between searches, and the stack.
+     * @param history  Hashes of the game positions before pos, oldest first.
+     * @param r_ponder_move  Expected reply to the best move (may be null).
+     * @param r_info  Nodes searched and other counts.
      */
-    Move search(Transposition::TPTable& tptable, Position& pos, int maxdepth, int movetime);
+    Move search(Transposition::TPTable& tptable, EvalCache& eval_cache,
+            Eval::PawnTable& pawn_table, SearchTables& tables, Position& pos,
+            const std::vector<ull>& history, const Limits& limits, const Options& options,
+            Signals& signals, Move& r_ponder_move, SearchInfo& r_info);
+
+    /**
+     * Print TP table diagnostics: sampled occupancy by age and depth, and probe and
+     * write counts of the last search (STATS builds only).
+     */
+    void print_tt_stats(const Transposition::TPTable& tptable, std::ostream& os);
+
+    /**
+     * print_tt_stats() data as a JSON object.
+     */
+    std::string tt_stats_json(const Transposition::TPTable& tptable);
+
+    /**
+     * Search the built-in bench positions to depth with a cleared TP table of hash_mb,
+     * and print total nodes (a signature of the search) and nps.
+     * With SF_ALLOC_STATS, also prints heap allocations.
+     * If threads > 1, also runs 1, 2, 4 ... threads independent copies of the
+     * suite at once, each with its own table, and prints the nps of each.
+     */
+    void bench(int depth, int threads, int hash_mb);
+
+    /**
+     * Proof number search for a forced mate in limits.mate moves (UCI go mate).
+     * Prints the mating line, or that none was found within the node table or time.
+     * @return  First move of the mate, else the most promising move.
+     */
+    Move mate_search(Position& pos, const Limits& limits, Signals& signals);
+
+    /**
+     * Runs search() on its own thread, so UCI commands are still read during search.
+     * Prints bestmove when done.
+     */
+    class SearchThread {
+    public:
+        SearchThread() : eval_cache(Options().eval_cache_kb),
+                tables(std::make_unique<SearchTables>()) {
+        }
+
+        ~SearchThread() {
+            stop();
+            wait();
+        }
+
+        /**
+         * Start searching a copy of pos. Waits for the previous search first.
+         * @param history  Hashes of the game positions before pos.
+         */
+        void start(Transposition::TPTable& tptable, const Position& pos,
+                const std::vector<ull>& history, const Limits& limits, const Options& options);
+
+        /**
+         * Ask the search to finish. Returns immediately.
+         */
+        void stop() {
+            signals.stop = true;
+        }
+
+        /**
+         * Opponent played the pondered move: continue as a normal timed search.
+         */
+        void ponderhit() {
+            signals.ponder = false;
+        }
+
+        /**
+         * Block until the search has printed bestmove.
+         */
+        void wait() {
+            if (thread.joinable())
+                thread.join();
+        }
+
+        /**
+         * Empty the caches kept between searches, sized from options.
+         * For ucinewgame and setoption; the search must be finished.
+         */
+        void clear(const Options& options) {
+            eval_cache.reset(options.eval_cache_kb);
+            pawn_table.clear();
+            tables->clear();
+        }
+
+    private:
+        std::thread thread;
+        EvalCache eval_cache;
+        Eval::PawnTable pawn_table;
+        std::unique_ptr<SearchTables> tables;
+        Signals signals;
+        Position pos;
+        std::vector<ull> history;
+        Limits limits;
+        Options options;
+    };
 
     /**
-     * Computes move time from UCI args, e.g. wtime
+     * Computes soft and hard time limits in ms from UCI args, e.g. wtime.
+     * Both are infinite (1e9) without time args, and equal for movetime.
      */
-    int get_movetime(const Position& pos, std::map<std::string, int>& args);
+    void get_time_limits(const Position& pos, std::map<std::string, long long>& args, int& r_soft,
+            int& r_hard);
 }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "sfmovegen.hpp"
+#include "sfutils.hpp"
+
+
+namespace Search {
+    constexpr int MAX_PLY = 128;
+
+    // Quiet moves remembered per node for history penalties.
+    constexpr int MAX_QUIETS = 64;
+
+    struct ScoredMove {
+        Move move;
+        int score;
+    };
+
+    /**
+     * Per-ply search data, preallocated once per search thread and indexed by ply,
+     * so searching a node never allocates.
+     */
+    struct Stack {
+        // Triangular PV table row: best line from this ply.
+        Move pv[MAX_PLY];
+        int pv_length;
+
+        int static_eval;
+
+        // Hash of the position at this ply, for repetition detection.
+        ull key;
+
+        // Move currently searched from this ply (null for null move).
+        Move move;
+
+        // Two quiet moves that caused cutoffs at this ply.
+        Move killers[2];
+
+        // Move list buffer for the MovePicker.
+        ScoredMove moves[Movegen::MAX_MOVES];
+
+        // Quiet moves searched so far.
+        Move quiets[MAX_QUIETS];
+        int quiet_count;
+
+        /**
+         * Set PV to move followed by the child's PV.
+         */
+        inline void update_pv(const Move& best, const Stack& child) {
+            pv[0] = best;
+            for (int i = 0; i < child.pv_length; i++)
+                pv[i+1] = child.pv[i];
+            pv_length = child.pv_length + 1;
+        }
+    };
+}
@@ -0,0 +1,91 @@
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "stats.hpp"
+
+
+namespace Search {
+
+
+#ifdef SF_STATS
+
+/**
+ * Ratio as percent with one decimal.
+ */
+static inline std::string percent(ull num, ull den) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1) << (den == 0 ? 0.0 : 100.0 * num / den);
+    return os.str();
+}
+
+
+void StatsLog::iteration_done(int depth, int elapse, ull nodes, ull cutoffs,
+        ull first_move_cutoffs, const SearchStats& stats) {
+    double ebf = 0;
+    if (!iterations.empty()) {
+        const Iteration& last = iterations.back();
+        const ull prev_nodes = iterations.size() >= 2 ? iterations[iterations.size()-2].nodes : 0;
+        const ull last_nodes = last.nodes - prev_nodes;
+        if (last_nodes > 0)
+            ebf = (double)(nodes - last.nodes) / last_nodes;
+    }
+    iterations.push_back({depth, elapse, nodes, cutoffs, first_move_cutoffs, stats, ebf});
+}
+
+std::string StatsLog::info() const {
+    if (iterations.empty())
+        return "";
+    const Iteration& it = iterations.back();
+    const SearchStats& s = it.stats;
+
+    std::ostringstream os;
+    os << "info string stats depth " << it.depth
+        << " mainnodes " << s.main_nodes
+        << " qnodes " << s.qnodes << " (" << percent(s.qnodes, it.nodes) << "%)"
+        << " ttprobes " << s.tt_probes
+        << " tthits " << percent(s.tt_hits, s.tt_probes) << "%"
+        << " ttcutoffs " << s.tt_cutoffs
+        << " evalhits " << percent(s.eval_hits, s.eval_probes) << "%"
+        << " cutoffs " << it.cutoffs
+        << " firstmove " << percent(it.first_move_cutoffs, it.cutoffs) << "%"
+        << " pvsresearch " << s.pvs_researches
+        << " lmrresearch " << s.lmr_researches
+        << " aspresearch " << s.aspiration_researches
+        << " ebf " << std::fixed << std::setprecision(2) << it.ebf;
+    return os.str();
+}
+
+bool StatsLog::dump(const std::string& path, const std::string& fen,
+        const std::string& tt) const {
+    std::ofstream fp(path, std::ios::app);
+    fp << "{\"fen\": \"" << fen << "\", \"iterations\": [";
+    for (size_t i = 0; i < iterations.size(); i++) {
+        const Iteration& it = iterations[i];
+        const SearchStats& s = it.stats;
+        fp << (i == 0 ? "" : ", ")
+            << "{\"depth\": " << it.depth
+            << ", \"time\": " << it.elapse
+            << ", \"nodes\": " << it.nodes
+            << ", \"main_nodes\": " << s.main_nodes
+            << ", \"qnodes\": " << s.qnodes
+            << ", \"tt_probes\": " << s.tt_probes
+            << ", \"tt_hits\": " << s.tt_hits
+            << ", \"tt_cutoffs\": " << s.tt_cutoffs
+            << ", \"eval_probes\": " << s.eval_probes
+            << ", \"eval_hits\": " << s.eval_hits
+            << ", \"cutoffs\": " << it.cutoffs
+            << ", \"first_move_cutoffs\": " << it.first_move_cutoffs
+            << ", \"pvs_researches\": " << s.pvs_researches
+            << ", \"lmr_researches\": " << s.lmr_researches
+            << ", \"aspiration_researches\": " << s.aspiration_researches
+            << ", \"ebf\": " << it.ebf << "}";
+    }
+    fp << "], \"tt\": " << tt << "}\n";
+    return (bool)fp;
+}
+
+#endif
+
+
+}
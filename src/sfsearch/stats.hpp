@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sfutils.hpp"
+
+
+/**
+ * Detailed search statistics, only collected when built with -DSTATS=ON (defines SF_STATS).
+ * Statements wrapped in STATS() compile to nothing otherwise.
+ */
+#ifdef SF_STATS
+#define STATS(...) __VA_ARGS__
+#else
+#define STATS(...)
+#endif
+
+
+namespace Search {
+    /**
+     * Counters of one search, cumulative over iterations.
+     */
+    struct SearchStats {
+        ull main_nodes = 0, qnodes = 0;
+        ull tt_probes = 0, tt_hits = 0, tt_cutoffs = 0;
+        // Static evals not found in the TP, and how many of them the eval cache had.
+        ull eval_probes = 0, eval_hits = 0;
+        // Null window move that beat alpha at a PV node, searched again with full window.
+        ull pvs_researches = 0;
+        // Reduced move that beat alpha, searched again at full depth.
+        ull lmr_researches = 0;
+        // Root searched again with a wider aspiration window.
+        ull aspiration_researches = 0;
+    };
+
+    /**
+     * Statistics of each iteration of one search.
+     */
+    class StatsLog {
+    public:
+        /**
+         * Record a completed iteration. Counters are cumulative since search start.
+         */
+        void iteration_done(int depth, int elapse, ull nodes, ull cutoffs,
+            ull first_move_cutoffs, const SearchStats& stats);
+
+        /**
+         * UCI "info string" line for the last iteration.
+         */
+        std::string info() const;
+
+        /**
+         * Append all iterations as one JSON line to file.
+         * @param tt  JSON object of TP table diagnostics.
+         * @return  false if file can't be written.
+         */
+        bool dump(const std::string& path, const std::string& fen, const std::string& tt) const;
+
+    private:
+        struct Iteration {
+            int depth, elapse;
+            ull nodes, cutoffs, first_move_cutoffs;
+            SearchStats stats;
+            // Nodes of this iteration over nodes of the previous one (0 for the first).
+            double ebf;
+        };
+
+        std::vector<Iteration> iterations;
+    };
+}
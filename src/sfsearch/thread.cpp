@@ -0,0 +1,49 @@
+#include "sfsearch.hpp"
+#include "sfuci.hpp"
+#include "sfutils.hpp"
+
+
+namespace Search {
+
+
+/**
+ * UCI: a null move, e.g. when the root has no legal moves, is sent as 0000.
+ */
+static std::string move2uci(const Move& move) {
+    return move.is_null() ? "0000" : move.uci();
+}
+
+
+void SearchThread::start(Transposition::TPTable& tptable, const Position& pos,
+        const std::vector<ull>& history, const Limits& limits, const Options& options) {
+    wait();
+
+    // Copies, so the caller may change them while searching.
+    this->pos = pos;
+    this->history = history;
+    this->limits = limits;
+    this->options = options;
+    signals.stop = false;
+    signals.ponder = limits.ponder;
+
+    thread = std::thread([this, &tptable] {
+        Move ponder_move;
+        SearchInfo info;
+        Profile::reset();
+        Move best_move;
+        if (this->limits.mate > 0)
+            best_move = mate_search(this->pos, this->limits, signals);
+        else
+            best_move = search(tptable, eval_cache, pawn_table, *tables, this->pos,
+                    this->history, this->limits, this->options, signals, ponder_move, info);
+        Profile::publish();
+
+        std::string line = "bestmove " + move2uci(best_move);
+        if (!ponder_move.is_null())
+            line += " ponder " + ponder_move.uci();
+        uci_send(line);
+    });
+}
+
+
+}
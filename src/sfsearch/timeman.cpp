@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "sfsearch.hpp"
+#include "sfutils.hpp"
+#include "timeman.hpp"
+
+
+namespace Search {
+
+
+// Assumed branching factor until two iterations took measurable time.
+constexpr double DEFAULT_EBF = 3;
+constexpr double MIN_EBF = 1.5, MAX_EBF = 6;
+
+
+TimeManager::TimeManager(int soft, int hard) {
+    this->soft = soft;
+    this->hard = hard;
+    last_elapse = 0;
+    last_duration = prev_duration = 0;
+    stability = 0;
+    eval = 0;
+    eval_drop = 0;
+    iterations = 0;
+}
+
+void TimeManager::iteration_done(int elapse, const Move& best_move, int eval) {
+    prev_duration = last_duration;
+    last_duration = elapse - last_elapse;
+    last_elapse = elapse;
+
+    stability = (iterations > 0 && best_move == this->best_move) ? stability + 1 : 0;
+    eval_drop = iterations > 0 ? std::max(this->eval - eval, 0) : 0;
+    this->best_move = best_move;
+    this->eval = eval;
+    iterations++;
+}
+
+bool TimeManager::should_continue(int elapse) const {
+    if (elapse >= target())
+        return false;
+    // Would be aborted by the hard limit: the partial iteration is wasted.
+    return elapse + predict_next() <= hard;
+}
+
+int TimeManager::target() const {
+    if (soft >= hard)
+        return hard;
+
+    // Stable best move: less time. Falling eval: more, to find a better move.
+    double scale = 1;
+    if (stability >= 6)
+        scale = 0.5;
+    else if (stability >= 3)
+        scale = 0.75;
+    else if (stability == 0)
+        scale = 1.25;
+
+    if (eval_drop >= 60)
+        scale *= 2;
+    else if (eval_drop >= 25)
+        scale *= 1.5;
+
+    return std::min((int)(soft * scale), hard);
+}
+
+int TimeManager::predict_next() const {
+    double ebf = DEFAULT_EBF;
+    if (prev_duration >= 2)
+        ebf = std::min(std::max((double)last_duration / prev_duration, MIN_EBF), MAX_EBF);
+    return last_duration * ebf;
+}
+
+
+void get_time_limits(const Position& pos, std::map<std::string, long long>& args, int& r_soft,
+        int& r_hard) {
+    r_soft = r_hard = 1e9;  // Defaults to inf.
+    // Times beyond that are as good as infinite.
+    auto get = [&args](const char* name) { return (int)std::min(args[name], (long long)1e9); };
+    if (args.count("movetime")) {
+        r_soft = r_hard = get("movetime");
+        return;
+    }
+
+    int time_left = -1, time_inc = 0;
+    if (pos.turn) {
+        if (args.count("wtime")) time_left = get("wtime");
+        if (args.count("winc")) time_inc = get("winc");
+    } else {
+        if (args.count("btime")) time_left = get("btime");
+        if (args.count("binc")) time_inc = get("binc");
+    }
+
+    if (time_left == -1)
+        return;
+
+    // Soft: fair share of remaining time. Hard: room for a difficult move.
+    int moves_left = std::max(50-pos.move, 12);
+    int est_time_left = time_left + moves_left*time_inc;
+    int move_time = est_time_left / moves_left;
+    r_hard = std::min(3 * move_time, (int)(time_left * 0.6));
+    r_soft = std::min((int)(move_time * 0.6), r_hard);
+}
+
+
+}
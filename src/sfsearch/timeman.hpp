@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sfutils.hpp"
+
+
+namespace Search {
+    /**
+     * Decides between iterations of iterative deepening whether to search deeper.
+     * The hard limit is enforced during search (SearchState::should_stop); this only
+     * avoids starting iterations that would be aborted, and adapts the soft limit to
+     * how settled the search is.
+     */
+    class TimeManager {
+    public:
+        /**
+         * @param soft  Target time in ms.
+         * @param hard  Time in ms after which search is aborted. If not above soft,
+         *     the whole time is used (e.g. UCI movetime).
+         */
+        TimeManager(int soft, int hard);
+
+        /**
+         * Record a completed iteration.
+         * @param elapse  ms since search start, at the end of the iteration.
+         * @param eval  Root eval, relative to root's turn.
+         */
+        void iteration_done(int elapse, const Move& best_move, int eval);
+
+        /**
+         * Whether the next iteration should be started.
+         * @param elapse  ms since search start.
+         */
+        bool should_continue(int elapse) const;
+
+    private:
+        int soft, hard;
+
+        // Elapsed time at end of the previous two iterations, and their durations.
+        int last_elapse;
+        int last_duration, prev_duration;
+
+        // Consecutive iterations with the same best move.
+        int stability;
+        Move best_move;
+        int eval;
+        // Eval drop in the last iteration (0 if it rose).
+        int eval_drop;
+        int iterations;
+
+        /**
+         * Soft limit scaled by best move stability and eval drop.
+         */
+        int target() const;
+
+        /**
+         * Estimated duration of the next iteration, from the observed branching factor.
+         */
+        int predict_next() const;
+    };
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <chrono>
+
+#include "trace.hpp"
+
+
+namespace Search {
+
+
+#ifdef SF_TRACE
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path) {
+    close();
+    fp = std::fopen(path.c_str(), "wb");
+    if (fp == nullptr)
+        return false;
+    std::fwrite(TRACE_MAGIC, 1, 4, fp);
+
+    ring.resize(RING_SIZE);
+    head = tail = 0;
+    done = false;
+    writer = std::thread(&TraceWriter::drain, this);
+    return true;
+}
+
+void TraceWriter::close() {
+    if (fp == nullptr)
+        return;
+    done = true;
+    writer.join();
+    std::fclose(fp);
+    fp = nullptr;
+}
+
+void TraceWriter::drain() {
+    while (true) {
+        // Read done first, so records written before close() are not missed.
+        const bool finished = done.load(std::memory_order_acquire);
+        const size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == h) {
+            if (finished)
+                return;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+
+        // Contiguous part of the ring.
+        while (t < h) {
+            const size_t count = std::min(h - t, RING_SIZE - t % RING_SIZE);
+            std::fwrite(&ring[t % RING_SIZE], sizeof(TraceRecord), count, fp);
+            t += count;
+            tail.store(t, std::memory_order_release);
+        }
+    }
+}
+
+#endif
+
+
+}
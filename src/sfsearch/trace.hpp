@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Search tree tracing, only compiled in with -DTRACE=ON (defines SF_TRACE).
+ * Statements wrapped in TRACE() compile to nothing otherwise.
+ *
+ * Each node writes one TraceRecord when it returns, so records are in post-order:
+ * a node's subtree is the records since the previous record at its ply or lower.
+ */
+#ifdef SF_TRACE
+#define TRACE(...) __VA_ARGS__
+#else
+#define TRACE(...)
+#endif
+
+
+namespace Search {
+    // Trace file header.
+    constexpr char TRACE_MAGIC[4] = {'S', 'F', 'T', 'R'};
+
+    // TraceRecord::flags bits.
+    constexpr uint8_t
+        TRACE_TT_HIT = 1,
+        TRACE_CUTOFF = 2,
+        // Search was stopped in the node, so its score is not a result.
+        TRACE_ABORTED = 4;
+
+    /**
+     * One searched node, as stored in the trace file (little endian).
+     */
+    #pragma pack(push, 1)
+    struct TraceRecord {
+        uint8_t ply;
+        int8_t depth;
+        // NodeType of search.cpp: root, PV, non PV, qsearch.
+        uint8_t node_type;
+        uint8_t flags;
+        // Move leading to this node: from | to << 6 | promo << 12 (0 for root and null move).
+        uint16_t move;
+        // Moves searched before the cutoff, including the cutoff move (0 if none).
+        uint8_t cutoff_index;
+        uint8_t reserved;
+        int32_t alpha, beta, score;
+    };
+    #pragma pack(pop)
+
+    static_assert(sizeof(TraceRecord) == 20);
+
+    /**
+     * Streams records to a file through a ring buffer drained by a writer thread,
+     * so memory use is constant however large the search.
+     */
+    class TraceWriter {
+    public:
+        ~TraceWriter();
+
+        /**
+         * Start writing to path (truncated).
+         * @return  false if file can't be opened.
+         */
+        bool open(const std::string& path);
+
+        /**
+         * Drain buffer and close file.
+         */
+        void close();
+
+        inline bool is_open() const {
+            return fp != nullptr;
+        }
+
+        /**
+         * Append record. Waits if the writer thread is behind by a whole buffer.
+         */
+        inline void write(const TraceRecord& record) {
+            const size_t h = head.load(std::memory_order_relaxed);
+            while (h - tail.load(std::memory_order_acquire) >= RING_SIZE)
+                std::this_thread::yield();
+            ring[h % RING_SIZE] = record;
+            head.store(h + 1, std::memory_order_release);
+        }
+
+    private:
+        static constexpr size_t RING_SIZE = 1 << 16;
+
+        FILE* fp = nullptr;
+        std::vector<TraceRecord> ring;
+        // Records written by the search (head) and by the writer thread (tail).
+        std::atomic<size_t> head, tail;
+        std::atomic<bool> done;
+        std::thread writer;
+
+        void drain();
+    };
+}
@@ -1,26 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+#include "sfutils.hpp"
+#include "stats.hpp"
+
+
 /**
  * Call Transposition::init() before using.
  */
 namespace Transposition {
+    /**
+     * What the stored eval means relative to the true score.
+     */
+    constexpr char
+        BOUND_NONE = 0,
+        BOUND_UPPER = 1,  // Failed low: true score <= eval.
+        BOUND_LOWER = 2,  // Failed high: true score >= eval.
+        BOUND_EXACT = 3;
+
+    // Static eval not computed (in check or at root).
+    constexpr int EVAL_NONE = INT32_MIN;
+
     /**
      * Transposition entry.
      */
     struct TP {
         ull hash;
+        int eval;
+        // Eval of the position itself, relative to its turn, so it needn't be recomputed.
+        int static_eval;
+        Move best_move;
         // Depth of search
         char depth;
-        int eval, alpha, beta;
-        Move best_move;
+        char bound;
         // Search index specific to this.
         uint16_t search_index;
 
         TP() {
             // This means unitialized
             depth = -1;
+            bound = BOUND_NONE;
+            static_eval = EVAL_NONE;
             search_index = -1;
         }
     };
 
+    /**
+     * Probe and write counts, for diagnostics. Only counted in STATS builds.
+     */
+    struct TPCounters {
+        // Probe found: the position, an empty slot, or another position.
+        ull probes = 0, hits = 0, empty = 0, collisions = 0;
+        // Writes by what the slot held: nothing, the same position, another position
+        // from an older search, or another position from this search.
+        ull write_empty = 0, write_update = 0, write_old = 0, write_replace = 0;
+    };
+
     /**
      * Transposition table.
      */
@@ -28,6 +65,8 @@ namespace Transposition {
     public:
         // Which search we are currently doing e.g. 1st, 2nd, 3rd, etc.
         uint16_t search_index;
+        // Since the last reset, usually the start of the last search. Zero without STATS.
+        TPCounters counters;
 
         ~TPTable() {
             delete[] table;
@@ -42,7 +81,19 @@ namespace Transposition {
             init_hash();
         }
 
+        /**
+         * Empty all entries, e.g. for reproducible searches.
+         */
+        void clear() {
+            for (int i = 0; i < size; i++)
+                table[i] = TP();
+            used = 0;
+            search_index = 0;
+            counters = TPCounters();
+        }
+
         inline ull hash(const Position& pos) {
+            PROFILE_SCOPE(TT_HASH);
             ull digest = 0;
     
             for (int sq = 0; sq < 64; sq++) {
@@ -58,20 +109,51 @@ namespace Transposition {
         }
 
         inline TP* get(ull hash) {
+            PROFILE_SCOPE(TT_GET);
             return &table[hash % size];
         }
 
-        inline void set(ull hash, char depth, int eval, int alpha, int beta, Move best_move) {
+        /**
+         * get(), counting the probe as a hit, empty or collision.
+         */
+        inline TP* probe(ull hash) {
+            TP* tp = get(hash);
+            STATS(
+                counters.probes++;
+                if (tp->depth == -1)
+                    counters.empty++;
+                else if (tp->hash == hash)
+                    counters.hits++;
+                else
+                    counters.collisions++;
+            )
+            return tp;
+        }
+
+        inline void set(ull hash, char depth, int eval, char bound, Move best_move,
+                int static_eval) {
+            PROFILE_SCOPE(TT_SET);
             TP* tp = get(hash);
             if (tp->depth == -1)
                 used++;
+            STATS(
+                if (tp->depth == -1)
+                    counters.write_empty++;
+                else if (tp->hash == hash)
+                    counters.write_update++;
+                else if (tp->search_index != search_index)
+                    counters.write_old++;
+                else
+                    counters.write_replace++;
+            )
 
             tp->hash = hash;
             tp->depth = depth;
+            tp->bound = bound;
             tp->eval = eval;
-            tp->alpha = alpha;
-            tp->beta = beta;
             tp->best_move = best_move;
+            tp->static_eval = static_eval;
+            tp->search_index = search_index;
         }
 
         /**
@@ -81,6 +163,14 @@ namespace Transposition {
             return 1000ULL * used / size;
         }
 
+        inline int get_size() const {
+            return size;
+        }
+
+        inline const TP& at(int i) const {
+            return table[i];
+        }
+
     private:
         TP* table;
         int size;
@@ -91,16 +181,18 @@ namespace Transposition {
             HASH_TURN[2];
 
         void init_hash() {
-            // Set hash bits.
+            // Set hash bits. Fixed seed, so every table hashes the same and
+            // searches are reproducible.
+            std::mt19937_64 rng(20240101);
             for (int i = 0; i < 12; i++)
                 for (int j = 0; j < 64; j++)
-                    HASH_PIECES[i][j] = Random::randull();
+                    HASH_PIECES[i][j] = rng();
             for (int i = 0; i < 16; i++)
-                HASH_CASTLE[i] = Random::randull();
+                HASH_CASTLE[i] = rng();
             for (int i = 0; i < 8; i++)
-                HASH_EP[i] = Random::randull();
+                HASH_EP[i] = rng();
             for (int i = 0; i < 2; i++)
-                HASH_TURN[i] = Random::randull();
+                HASH_TURN[i] = rng();
         }
     };
 }
@@ -0,0 +1,127 @@
+#include <iomanip>
+#include <sstream>
+
+#include "sfsearch.hpp"
+
+
+namespace Search {
+
+
+using Transposition::TP;
+using Transposition::TPTable;
+
+// Entries sampled for occupancy.
+constexpr int TT_SAMPLE = 10000;
+// Age buckets: this search, 1, 2, 3+ searches old.
+constexpr int AGE_BUCKETS = 4;
+// Depth buckets: qsearch (0), 1 ... 15, 16+.
+constexpr int DEPTH_BUCKETS = 17;
+
+
+/**
+ * Occupancy of evenly spaced table entries.
+ */
+struct TTSample {
+    int count = 0;
+    int empty = 0;
+    int age[AGE_BUCKETS] = {};
+    int depth[DEPTH_BUCKETS] = {};
+};
+
+static TTSample sample(const TPTable& tptable) {
+    TTSample s;
+    const int size = tptable.get_size();
+    const int step = std::max(size / TT_SAMPLE, 1);
+    for (int i = 0; i < size && s.count < TT_SAMPLE; i += step) {
+        const TP& tp = tptable.at(i);
+        s.count++;
+        if (tp.depth == -1) {
+            s.empty++;
+            continue;
+        }
+        const uint16_t age = tptable.search_index - tp.search_index;
+        s.age[std::min((int)age, AGE_BUCKETS - 1)]++;
+        s.depth[std::min(std::max((int)tp.depth, 0), DEPTH_BUCKETS - 1)]++;
+    }
+    return s;
+}
+
+static inline double ratio(ull num, ull den) {
+    return den == 0 ? 0 : (double)num / den;
+}
+
+static inline double to_mb(double entries) {
+    return entries * sizeof(TP) / (1 << 20);
+}
+
+/**
+ * Positions the last search stored in a new slot: an upper bound of its working set.
+ */
+static inline ull new_positions(const Transposition::TPCounters& c) {
+    return c.write_empty + c.write_old + c.write_replace;
+}
+
+
+void print_tt_stats(const TPTable& tptable, std::ostream& os) {
+    const TTSample s = sample(tptable);
+    const int size = tptable.get_size();
+
+    os << std::fixed << std::setprecision(1);
+    os << "Size: " << size << " entries (" << to_mb(size) << " MB)\n";
+    os << "Sampled " << s.count << " entries: " << 100 * ratio(s.empty, s.count) << "% empty\n";
+    const char* age_names[AGE_BUCKETS] = {"this search", "1 search old", "2 searches old",
+        "3+ searches old"};
+    for (int i = 0; i < AGE_BUCKETS; i++)
+        os << "  " << age_names[i] << ": " << 100 * ratio(s.age[i], s.count) << "%\n";
+
+    os << "Depth histogram (sampled):\n";
+    for (int i = 0; i < DEPTH_BUCKETS; i++) {
+        if (s.depth[i] == 0)
+            continue;
+        os << "  " << (i == 0 ? "qsearch" : std::to_string(i) + (i == DEPTH_BUCKETS-1 ? "+" : ""))
+            << ": " << 100 * ratio(s.depth[i], s.count - s.empty) << "%\n";
+    }
+
+#ifdef SF_STATS
+    const Transposition::TPCounters& c = tptable.counters;
+    os << "Probes (last search): " << c.probes << ", hit " << 100 * ratio(c.hits, c.probes)
+        << "%, empty " << 100 * ratio(c.empty, c.probes)
+        << "%, collision " << 100 * ratio(c.collisions, c.probes) << "%\n";
+    const ull writes = c.write_empty + c.write_update + c.write_old + c.write_replace;
+    os << "Writes (last search): " << writes << ", empty slot " << c.write_empty
+        << ", same position " << c.write_update << ", older search " << c.write_old
+        << ", this search (replaced) " << c.write_replace << "\n";
+
+    // Working set: what the search tried to keep, and what is still there.
+    const double kept = ratio(s.age[0], s.count) * size;
+    os << "Working set: " << new_positions(c) << " new positions ("
+        << to_mb(new_positions(c)) << " MB), " << (ull)kept << " kept (" << to_mb(kept)
+        << " MB)\n";
+#else
+    os << "Probe and write counts need a build with -DSTATS=ON\n";
+#endif
+    os << std::defaultfloat << std::flush;
+}
+
+std::string tt_stats_json(const TPTable& tptable) {
+    const TTSample s = sample(tptable);
+    const Transposition::TPCounters& c = tptable.counters;
+
+    std::ostringstream os;
+    os << "{\"size\": " << tptable.get_size() << ", \"sampled\": " << s.count
+        << ", \"empty\": " << s.empty << ", \"age\": [";
+    for (int i = 0; i < AGE_BUCKETS; i++)
+        os << (i == 0 ? "" : ", ") << s.age[i];
+    os << "], \"depth\": [";
+    for (int i = 0; i < DEPTH_BUCKETS; i++)
+        os << (i == 0 ? "" : ", ") << s.depth[i];
+    os << "], \"probes\": " << c.probes << ", \"hits\": " << c.hits
+        << ", \"probe_empty\": " << c.empty << ", \"collisions\": " << c.collisions
+        << ", \"write_empty\": " << c.write_empty << ", \"write_update\": " << c.write_update
+        << ", \"write_old\": " << c.write_old << ", \"write_replace\": " << c.write_replace
+        << ", \"new_positions\": " << new_positions(c) << "}";
+    return os.str();
+}
+
+
+}
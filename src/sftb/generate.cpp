@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "sfmovegen.hpp"
+#include "sftb.hpp"
+#include "sfutils.hpp"
+#include "table.hpp"
+
+
+namespace Tablebase {
+
+
+/**
+ * Run func(begin, end, thread) over [0, size) split among threads, and wait.
+ */
+template <typename F>
+static void parallel_for(ull size, int threads, F func) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back(func, size * t / threads, size * (t + 1) / threads, t);
+    for (std::thread& worker: workers)
+        worker.join();
+}
+
+
+// Piece boards, white then black, in code order.
+constexpr ull Position::* BOARDS[12] = {
+    &Position::wp, &Position::wn, &Position::wb, &Position::wr, &Position::wq, &Position::wk,
+    &Position::bp, &Position::bn, &Position::bb, &Position::br, &Position::bq, &Position::bk,
+};
+
+// Level after which nothing is scheduled.
+constexpr int NEVER = MAX_DTM + 2;
+
+
+/**
+ * One bit per table index, settable from several threads at once.
+ */
+class Bitmap {
+public:
+    Bitmap(ull size) : words((size + 63) / 64), bits(new std::atomic<ull>[words]) {
+        for (ull w = 0; w < words; w++)
+            bits[w].store(0, std::memory_order_relaxed);
+    }
+
+    inline void set(ull i) {
+        bits[i / 64].fetch_or(Bit::mask(i % 64), std::memory_order_relaxed);
+    }
+
+    /**
+     * Clear word w (bits 64 w ... 64 w + 63) and return what it was.
+     */
+    inline ull take(ull w) {
+        return bits[w].exchange(0, std::memory_order_relaxed);
+    }
+
+    const ull words;
+
+private:
+    std::unique_ptr<std::atomic<ull>[]> bits;
+};
+
+
+/**
+ * pos with every piece moved to its mirror square over the a1-h8 diagonal,
+ * or over the a8-h1 diagonal if anti.
+ */
+static Position mirror_diagonal(const Position& pos, bool anti) {
+    Position r = pos;
+    for (ull Position::* board: BOARDS) {
+        r.*board = 0;
+        ull b = pos.*board;
+        while (b) {
+            const int sq = Bit::pop_lsb(b);
+            const int rank = sq / 8, file = sq % 8;
+            r.*board |= Bit::mask(anti ? (7 - file) * 8 + 7 - rank : file * 8 + rank);
+        }
+    }
+    return r;
+}
+
+/**
+ * Add the indices of parent. Without pawns, kings on one long diagonal have two
+ * canonical forms, mirrored over it, and both are stored.
+ */
+static void add_parent(const Material& material, const Position& parent, Bitmap& r_marks) {
+    r_marks.set(material.index(parent));
+    if (material.has_pawns())
+        return;
+    const int wk = Bit::lsb(parent.wk), bk = Bit::lsb(parent.bk);
+    if (wk / 8 == wk % 8 && bk / 8 == bk % 8)
+        r_marks.set(material.index(mirror_diagonal(parent, false)));
+    else if (wk / 8 + wk % 8 == 7 && bk / 8 + bk % 8 == 7)
+        r_marks.set(material.index(mirror_diagonal(parent, true)));
+}
+
+/**
+ * Mark the positions of the table with a quiet move (no capture or promotion) to pos.
+ * Illegal positions may be marked too, but no parent is missed.
+ */
+static void mark_parents(const Material& material, const Position& pos, Bitmap& r_marks) {
+    // The side not to move made the last move.
+    const bool white = !pos.turn;
+    ull occupied = 0;
+    for (ull Position::* board: BOARDS)
+        occupied |= pos.*board;
+    const int other_king = Bit::lsb(white ? pos.bk : pos.wk);
+    const int forward = white ? 8 : -8;
+
+    Position parent = pos;
+    parent.turn = white;
+    for (int type = 0; type < 6; type++) {
+        ull& board = parent.*BOARDS[white ? type : type + 6];
+        ull pieces = board;
+        while (pieces) {
+            const int to = Bit::pop_lsb(pieces);
+            ull from = 0;
+            switch (type) {
+                case 0: {
+                    // Pushes, double from the second rank.
+                    const int single = to - forward;
+                    if (single < 8 || single >= 56 || Bit::get(occupied, single))
+                        break;
+                    from = Bit::mask(single);
+                    const int start = single - forward;
+                    if (start / 8 == (white ? 1 : 6) && !Bit::get(occupied, start))
+                        from |= Bit::mask(start);
+                    break;
+                }
+                case 1: from = Movegen::ATTACKS_KNIGHT[to]; break;
+                case 2: from = Movegen::attacks_bishop(to, occupied); break;
+                case 3: from = Movegen::attacks_rook(to, occupied); break;
+                case 4:
+                    from = Movegen::attacks_bishop(to, occupied)
+                        | Movegen::attacks_rook(to, occupied);
+                    break;
+                default:
+                    from = Movegen::ATTACKS_KING[to] & ~Movegen::ATTACKS_KING[other_king];
+                    break;
+            }
+            from &= ~occupied;
+
+            while (from) {
+                const ull move = Bit::mask(to) | Bit::mask(Bit::pop_lsb(from));
+                board ^= move;
+                add_parent(material, parent, r_marks);
+                board ^= move;
+            }
+        }
+    }
+}
+
+
+/**
+ * Value of the position after move, relative to its side to move.
+ * Same material is looked up in values (being generated), else in loaded tables.
+ * @param n  Current level: unresolved positions are not decided within n-1 plies.
+ * @param r_later  Lowered to the level at which an unresolved result changes
+ *     even if values don't.
+ */
+static inline uint8_t child_value(const Material& material, const std::vector<uint8_t>& values,
+        const Position& pos, const Move& move, int n, int& r_later) {
+    Position child = pos;
+    child.push(move);
+    // Table positions have no en passant rights, so captures are all normal.
+    if (pos.piece_at(move.to) != EMPTY || move.promo != Promo::NONE) {
+        Result result;
+        if (!probe(child, result)) {
+            std::cerr << "sftb:generate: Missing table for " << child.get_fen() << std::endl;
+            throw 0;
+        }
+        return encode(result.wdl, result.dtm);
+    }
+
+    const uint8_t value = values[material.index(child)];
+    if (child.ep == -1)
+        return value;
+
+    // After a double push, en passant captures add to the child's moves.
+    Result ep;
+    bool others;
+    const int count = probe_ep(child, ep, others);
+    if (count < 0) {
+        std::cerr << "sftb:generate: Missing table after " << child.get_fen() << std::endl;
+        throw 0;
+    }
+    if (count == 0)
+        return value;
+    if (!others)
+        return encode(ep.wdl, ep.dtm);
+    if (value != VALUE_UNRESOLVED)
+        return better(ep, decode(value)) ? encode(ep.wdl, ep.dtm) : value;
+    if (ep.wdl > 0 && ep.dtm < n)
+        return encode(ep.wdl, ep.dtm);
+    if (ep.wdl > 0)
+        r_later = std::min(r_later, ep.dtm + 1);
+    return VALUE_UNRESOLVED;
+}
+
+/**
+ * Value of unresolved pos at level n: won in n if a child is lost in n-1 plies,
+ * lost in n if all children are won in at most n-1, else VALUE_UNRESOLVED.
+ * @param r_later  If unresolved, the level at which the result changes even if
+ *     no child in this table resolves meanwhile, from captures into smaller tables
+ *     (NEVER if none).
+ */
+static uint8_t resolve(const Material& material, const std::vector<uint8_t>& values,
+        Position& pos, int n, int& r_later) {
+    Movegen::MoveList moves;
+    ull attacks;
+    Movegen::get_legal_moves(pos, moves, attacks);
+
+    r_later = NEVER;
+    bool all_win = true;
+    int max_win = 0;
+    for (const Move& move: moves) {
+        const uint8_t value = child_value(material, values, pos, move, n, r_later);
+        const Result result = decode(value);
+        if (value == VALUE_UNRESOLVED || result.wdl == 0) {
+            all_win = false;
+        } else if (result.wdl < 0) {
+            all_win = false;
+            if (result.dtm == n - 1)
+                return encode(1, n);
+            if (result.dtm >= n)
+                r_later = std::min(r_later, result.dtm + 1);
+        } else {
+            max_win = std::max(max_win, result.dtm);
+        }
+    }
+
+    if (all_win && max_win <= n - 1)
+        return encode(-1, n);
+    if (all_win)
+        r_later = std::min(r_later, max_win + 1);
+    return VALUE_UNRESOLVED;
+}
+
+
+/**
+ * Retrograde analysis by levels: at level n, positions with a child lost in n-1 plies
+ * are won in n, and positions whose children are all won in at most n-1 plies
+ * are lost in n. Captures and promotions are looked up in smaller tables.
+ * Level 1 looks at every position. After that, a level only looks at the parents
+ * (by un-moves) of the positions resolved in the previous level, and at positions
+ * scheduled for it because a capture decides them then.
+ * Positions still unresolved when nothing is left to look at are draws.
+ */
+static void build(const Material& material, int threads, std::vector<uint8_t>& r_values,
+        int& r_max_dtm) {
+    const ull size = material.size();
+    r_values.assign(size, VALUE_UNRESOLVED);
+
+    // Level 0: illegal positions, mates and stalemates.
+    parallel_for(size, threads, [&](ull begin, ull end, int) {
+        Position pos;
+        for (ull i = begin; i < end; i++) {
+            uint8_t& value = r_values[i];
+            if (!material.position(i, pos)) {
+                value = VALUE_ILLEGAL;
+                continue;
+            }
+            Position other = pos;
+            other.turn = !other.turn;
+            if (Movegen::in_check(other)) {
+                value = VALUE_ILLEGAL;
+                continue;
+            }
+
+            Movegen::MoveList moves;
+            ull attacks;
+            Movegen::get_legal_moves(pos, moves, attacks);
+            if (moves.size() == 0)
+                value = Movegen::in_check(pos) ? encode(-1, 0) : VALUE_DRAW;
+        }
+    });
+
+    // Positions to look at in the current level.
+    Bitmap frontier(size);
+    for (ull i = 0; i < size; i++)
+        if (r_values[i] == VALUE_UNRESOLVED)
+            frontier.set(i);
+    std::vector<std::vector<ull>> scheduled(NEVER);
+    ull pending = 0;
+
+    r_max_dtm = 0;
+    for (int n = 1; ; n++) {
+        if (n > MAX_DTM) {
+            std::cerr << "sftb:generate: DTM too long for " << material.name() << std::endl;
+            throw 0;
+        }
+        for (ull i: scheduled[n])
+            frontier.set(i);
+        pending -= scheduled[n].size();
+        std::vector<ull>().swap(scheduled[n]);
+
+        std::vector<std::vector<std::pair<ull, uint8_t>>> changes(threads);
+        std::vector<std::vector<std::pair<int, ull>>> later(threads);
+        parallel_for(frontier.words, threads, [&](ull begin, ull end, int t) {
+            Position pos;
+            for (ull w = begin; w < end; w++) {
+                ull bits = frontier.take(w);
+                while (bits) {
+                    const ull i = w * 64 + Bit::pop_lsb(bits);
+                    if (r_values[i] != VALUE_UNRESOLVED)
+                        continue;
+                    material.position(i, pos);
+                    int level;
+                    const uint8_t value = resolve(material, r_values, pos, n, level);
+                    if (value != VALUE_UNRESOLVED)
+                        changes[t].push_back({i, value});
+                    else if (level < NEVER)
+                        later[t].push_back({level, i});
+                }
+            }
+        });
+
+        ull count = 0;
+        for (const auto& list: changes) {
+            for (const auto& [index, value]: list)
+                r_values[index] = value;
+            count += list.size();
+        }
+        for (const auto& list: later) {
+            for (const auto& [level, index]: list)
+                scheduled[level].push_back(index);
+            pending += list.size();
+        }
+        if (count > 0)
+            r_max_dtm = n;
+        std::cout << material.name() << ": ply " << n << ", " << count << " positions"
+            << std::endl;
+
+        if (count == 0 && pending == 0)
+            break;
+
+        // Only parents of the resolved positions can resolve through them next.
+        parallel_for(threads, threads, [&](ull, ull, int t) {
+            Position pos;
+            for (const auto& [index, value]: changes[t]) {
+                material.position(index, pos);
+                mark_parents(material, pos, frontier);
+            }
+        });
+    }
+
+    for (uint8_t& value: r_values)
+        if (value == VALUE_UNRESOLVED)
+            value = VALUE_DRAW;
+}
+
+
+void generate(const std::string& dir, const std::string& name, int threads) {
+    const Material material(name);
+    if (material.pieces.size() <= 2 || find_table(material.key()) != nullptr)
+        return;
+
+    const std::string path = dir + "/" + material.name() + EXTENSION;
+    if (load(path))
+        return;
+
+    for (const Material& sub: material.successors())
+        generate(dir, sub.name(), threads);
+
+    std::vector<uint8_t> values;
+    int max_dtm;
+    build(material, threads, values, max_dtm);
+
+    uint8_t header[HEADER_SIZE] = {};
+    std::copy(MAGIC, MAGIC + 4, header);
+    header[4] = VERSION;
+    header[5] = material.pieces.size();
+    header[6] = max_dtm;
+    for (size_t i = 0; i < material.pieces.size() && 8 + i < HEADER_SIZE; i++)
+        header[8 + i] = material.pieces[i];
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> data;
+    compress(values, offsets, data);
+
+    std::ofstream fp(path, std::ios::binary);
+    fp.write((const char*)header, HEADER_SIZE);
+    fp.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+    fp.write((const char*)data.data(), data.size());
+    fp.close();
+    if (!fp || !load(path)) {
+        std::cerr << "sftb:generate: Could not write " << path << std::endl;
+        throw 0;
+    }
+}
+
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sfutils.hpp"
+
+
+/**
+ * Endgame tablebases: exact win/draw/loss and distance to mate for positions
+ * with few pieces.
+ *
+ * A table covers one material set, named like "KQvKR" (white pieces, then black).
+ * Only one color orientation is stored: positions of the mirrored material are
+ * probed with colors flipped. Positions are indexed by the pair of king squares,
+ * reduced by board symmetry (462 pairs, or 1806 with pawns, which only allow
+ * mirroring files), then by the set of squares of each group of like pieces.
+ * Each position is one byte, see encode(), and tables are stored run length
+ * compressed in blocks.
+ *
+ * En passant is not stored: probing resolves en passant captures in the smaller
+ * tables. Positions with castling rights are never probed.
+ */
+namespace Tablebase {
+    // File extension of table files.
+    const std::string EXTENSION = ".sftb";
+
+    // Most pieces (including kings) a table may have.
+    constexpr int MAX_PIECES = 5;
+
+    // Longest distance to mate that can be stored, in plies.
+    constexpr int MAX_DTM = 125;
+
+    // Stored values, relative to side to move. Wins are the DTM (odd),
+    // losses 128 + DTM (even).
+    constexpr uint8_t
+        VALUE_DRAW = 0,
+        VALUE_LOSS = 128,
+        VALUE_UNRESOLVED = 254,  // Only during generation.
+        VALUE_ILLEGAL = 255;
+
+    /**
+     * Result of a probe, relative to side to move.
+     */
+    struct Result {
+        // 1 win, 0 draw, -1 loss.
+        int wdl;
+        // Plies to mate with best play (0 if draw).
+        int dtm;
+    };
+
+    inline uint8_t encode(int wdl, int dtm) {
+        if (wdl == 0)
+            return VALUE_DRAW;
+        return wdl > 0 ? dtm : VALUE_LOSS + dtm;
+    }
+
+    inline Result decode(uint8_t value) {
+        if (value == VALUE_DRAW || value >= VALUE_UNRESOLVED)
+            return {0, 0};
+        if (value >= VALUE_LOSS)
+            return {-1, value - VALUE_LOSS};
+        return {1, value};
+    }
+
+    /**
+     * Piece codes of a material set, in table order:
+     * white king, other white pieces, black king, other black pieces.
+     */
+    class Material {
+    public:
+        std::vector<int> pieces;
+
+        /**
+         * Parse e.g. "KQvKR". Throws if invalid.
+         */
+        Material(const std::string& name);
+
+        /**
+         * Canonical name, stronger side first.
+         */
+        std::string name() const;
+
+        /**
+         * Piece counts packed into an integer, see key().
+         */
+        uint32_t key() const;
+
+        /**
+         * Number of positions (indices) in the table.
+         */
+        ull size() const;
+
+        /**
+         * Index of position with this material, in canonical orientation.
+         */
+        ull index(const Position& pos) const;
+
+        /**
+         * Set r_pos from index, in canonical orientation.
+         * @return  false if two pieces share a square.
+         */
+        bool position(ull index, Position& r_pos) const;
+
+        /**
+         * Materials reachable by one capture or promotion.
+         */
+        std::vector<Material> successors() const;
+
+        /**
+         * Whether there are pawns (so only file mirroring is allowed).
+         */
+        bool has_pawns() const;
+
+    private:
+        Material() {
+        }
+
+        /**
+         * Runs of like pieces after the kings: piece code and count.
+         */
+        std::vector<std::pair<int, int>> groups() const;
+
+        /**
+         * Sort pieces into table order, stronger side as white.
+         */
+        void canonicalize();
+    };
+
+    /**
+     * Material key of position: 3 bits of count per non-king piece code.
+     */
+    uint32_t key(const Position& pos);
+
+    /**
+     * Position with colors swapped and board flipped vertically; same side to move relative.
+     */
+    Position flip(const Position& pos);
+
+    /**
+     * Load all tables in directory, replacing loaded ones.
+     * @return  Number of tables loaded.
+     */
+    int init(const std::string& dir);
+
+    /**
+     * Map a single table file.
+     * @return  false on error.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * Most pieces of any loaded table (0 if none).
+     */
+    int max_pieces();
+
+    /**
+     * Look up position. Returns false if no table covers it (or it has castling rights).
+     * Kings only is always a draw. pos must be legal: illegal positions aren't stored,
+     * so they get the value of a neighbouring index.
+     */
+    bool probe(const Position& pos, Result& r_result);
+
+    /**
+     * Generate table and all tables it depends on, writing files to dir.
+     * Existing files are loaded instead of generated.
+     * @param threads  Worker threads.
+     */
+    void generate(const std::string& dir, const std::string& name, int threads);
+}
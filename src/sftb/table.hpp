@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sftb.hpp"
+
+
+namespace Tablebase {
+    // File header: magic, version, piece count, max DTM, then piece codes.
+    constexpr char MAGIC[4] = {'S', 'F', 'T', 'B'};
+    constexpr uint8_t VERSION = 2;
+    constexpr size_t HEADER_SIZE = 16;
+
+    // Values per compressed block.
+    constexpr ull BLOCK_SIZE = 1024;
+
+    /**
+     * A loaded (memory mapped) table.
+     * After the header, the file has an offset (uint64) into the data for each block
+     * and one past the last, then the blocks. A block is a list of runs:
+     * value byte, then run length as a varint (7 bits per byte, low first).
+     */
+    struct Table {
+        Material material;
+        uint32_t key;
+        // Key with colors swapped: positions with this key are probed flipped.
+        uint32_t flipped_key;
+        int max_dtm;
+
+        const uint64_t* offsets;
+        const uint8_t* data;
+        void* map;
+        size_t map_size;
+
+        /**
+         * Stored value at index, decoding its block.
+         * Unchecked: load() rejects files whose blocks don't decode within the data.
+         */
+        uint8_t value(ull index) const;
+    };
+
+    /**
+     * Loaded table of material with given canonical key, or nullptr.
+     */
+    const Table* find_table(uint32_t key);
+
+    /**
+     * Compress values into block offsets and data, see Table.
+     * Illegal positions are never probed, so they take the value before them
+     * to lengthen runs.
+     */
+    void compress(const std::vector<uint8_t>& values, std::vector<uint64_t>& r_offsets,
+        std::vector<uint8_t>& r_data);
+
+    /**
+     * Whether a is better than b for the side to move.
+     */
+    inline bool better(const Result& a, const Result& b) {
+        auto rank = [](const Result& r) {
+            return r.wdl > 0 ? 1000 - r.dtm : (r.wdl < 0 ? -1000 + r.dtm : 0);
+        };
+        return rank(a) > rank(b);
+    }
+
+    /**
+     * Probe the en passant captures of pos, whose children are in smaller tables.
+     * @param r_best  Best result among them, relative to pos's side to move.
+     * @param r_others  Whether pos has other legal moves.
+     * @return  Number of en passant captures, or -1 if a table is missing.
+     */
+    int probe_ep(const Position& pos, Result& r_best, bool& r_others);
+}
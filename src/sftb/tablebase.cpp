@@ -0,0 +1,662 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sfmovegen.hpp"
+#include "sftb.hpp"
+#include "sfutils.hpp"
+#include "table.hpp"
+
+
+namespace Tablebase {
+
+
+// Non-king pieces in name order, with value for deciding the stronger side.
+constexpr char LETTERS[] = "QRBNP";
+constexpr int WHITE_CODES[5] = {WQ, WR, WB, WN, WP};
+constexpr int BLACK_CODES[5] = {BQ, BR, BB, BN, BP};
+constexpr int STRENGTH[5] = {9, 5, 3, 3, 1};
+
+static std::vector<Table> tables;
+static int loaded_max_pieces = 0;
+
+
+static inline ull& board(Position& pos, int piece) {
+    switch (piece) {
+        case WP: return pos.wp;
+        case WN: return pos.wn;
+        case WB: return pos.wb;
+        case WR: return pos.wr;
+        case WQ: return pos.wq;
+        case WK: return pos.wk;
+        case BP: return pos.bp;
+        case BN: return pos.bn;
+        case BB: return pos.bb;
+        case BR: return pos.br;
+        case BQ: return pos.bq;
+        default: return pos.bk;
+    }
+}
+
+static inline ull board(const Position& pos, int piece) {
+    return board(const_cast<Position&>(pos), piece);
+}
+
+/**
+ * Name letter of a non-king piece code.
+ */
+static inline char letter(int piece) {
+    for (int i = 0; i < 5; i++)
+        if (WHITE_CODES[i] == piece || BLACK_CODES[i] == piece)
+            return LETTERS[i];
+    return '?';
+}
+
+/**
+ * Key bits of one piece code (3 bits per code, kings excluded).
+ */
+static inline int key_shift(int piece) {
+    return 3 * (piece < BP ? piece - WP : piece - BP + 5);
+}
+
+
+// Board symmetries, applied in this order.
+constexpr int MIRROR_FILE = 1, MIRROR_RANK = 2, MIRROR_DIAG = 4;
+
+static inline int transform(int sq, int t) {
+    if (t & MIRROR_FILE) sq ^= 7;
+    if (t & MIRROR_RANK) sq ^= 56;
+    if (t & MIRROR_DIAG) sq = ((sq & 7) << 3) | (sq >> 3);
+    return sq;
+}
+
+static inline bool kings_touch(int a, int b) {
+    return std::abs(a % 8 - b % 8) <= 1 && std::abs(a / 8 - b / 8) <= 1;
+}
+
+/**
+ * Canonical king pairs, indexed [pawns][white king][black king] (-1 if not canonical),
+ * and their squares by index. Without pawns, the white king is in the a1-d1-d4 triangle,
+ * and the black king on or below the a1-h8 diagonal if the white king is on it.
+ * With pawns, the white king is on files a-d.
+ */
+struct KingPairs {
+    int index[2][64][64];
+    std::vector<std::pair<int, int>> squares[2];
+};
+
+static const KingPairs KINGS = [] {
+    KingPairs k;
+    for (int pawns = 0; pawns < 2; pawns++) {
+        for (int wk = 0; wk < 64; wk++) {
+            for (int bk = 0; bk < 64; bk++) {
+                k.index[pawns][wk][bk] = -1;
+                const int x = wk % 8, y = wk / 8;
+                bool canonical = x < 4 && !kings_touch(wk, bk);
+                if (!pawns)
+                    canonical = canonical && y <= x && (y != x || bk / 8 <= bk % 8);
+                if (canonical) {
+                    k.index[pawns][wk][bk] = k.squares[pawns].size();
+                    k.squares[pawns].push_back({wk, bk});
+                }
+            }
+        }
+    }
+    return k;
+}();
+
+/**
+ * Binomial coefficients, C(n, k) for n <= 64 and k < MAX_PIECES.
+ */
+static const auto BINOMIAL = [] {
+    std::array<std::array<ull, MAX_PIECES>, 65> c {};
+    for (int n = 0; n <= 64; n++) {
+        c[n][0] = 1;
+        for (int k = 1; k < MAX_PIECES; k++)
+            c[n][k] = n == 0 ? 0 : c[n-1][k-1] + c[n-1][k];
+    }
+    return c;
+}();
+
+/**
+ * Squares a piece can stand on: pawns skip the first and last ranks.
+ */
+static inline int square_count(int piece) {
+    return piece == WP || piece == BP ? 48 : 64;
+}
+
+
+Material::Material(const std::string& name) {
+    const size_t v = name.find('v');
+    if (v == std::string::npos || name.size() < 3 || name[0] != 'K' || name[v+1] != 'K') {
+        std::cerr << "sftb:Material:Material: Invalid material: " << name << std::endl;
+        throw 0;
+    }
+
+    for (int side = 0; side < 2; side++) {
+        const std::string part = side == 0 ? name.substr(1, v - 1) : name.substr(v + 2);
+        pieces.push_back(side == 0 ? WK : BK);
+        for (char ch: part) {
+            const char* found = std::strchr(LETTERS, ch);
+            if (ch == '\0' || found == nullptr) {
+                std::cerr << "sftb:Material:Material: Invalid material: " << name << std::endl;
+                throw 0;
+            }
+            const int i = found - LETTERS;
+            pieces.push_back(side == 0 ? WHITE_CODES[i] : BLACK_CODES[i]);
+        }
+    }
+    if ((int)pieces.size() > MAX_PIECES) {
+        std::cerr << "sftb:Material:Material: Too many pieces: " << name << std::endl;
+        throw 0;
+    }
+    canonicalize();
+}
+
+void Material::canonicalize() {
+    int counts[13] = {};
+    for (int piece: pieces)
+        counts[piece]++;
+
+    // Compare strength, then piece counts in name order.
+    int strength[2] = {0, 0};
+    for (int i = 0; i < 5; i++) {
+        strength[0] += STRENGTH[i] * counts[WHITE_CODES[i]];
+        strength[1] += STRENGTH[i] * counts[BLACK_CODES[i]];
+    }
+    bool swap = strength[1] > strength[0];
+    for (int i = 0; i < 5 && strength[0] == strength[1]; i++) {
+        if (counts[WHITE_CODES[i]] != counts[BLACK_CODES[i]]) {
+            swap = counts[BLACK_CODES[i]] > counts[WHITE_CODES[i]];
+            break;
+        }
+    }
+
+    pieces.clear();
+    for (int side = 0; side < 2; side++) {
+        const bool white = (side == 0) != swap;
+        pieces.push_back(side == 0 ? WK : BK);
+        for (int i = 0; i < 5; i++) {
+            const int n = counts[white ? WHITE_CODES[i] : BLACK_CODES[i]];
+            for (int j = 0; j < n; j++)
+                pieces.push_back(side == 0 ? WHITE_CODES[i] : BLACK_CODES[i]);
+        }
+    }
+}
+
+std::string Material::name() const {
+    std::string name;
+    for (int piece: pieces) {
+        if (piece == BK)
+            name += "vK";
+        else if (piece == WK)
+            name += "K";
+        else
+            name += letter(piece);
+    }
+    return name;
+}
+
+uint32_t Material::key() const {
+    uint32_t key = 0;
+    for (int piece: pieces)
+        if (piece != WK && piece != BK)
+            key += 1 << key_shift(piece);
+    return key;
+}
+
+bool Material::has_pawns() const {
+    return std::count(pieces.begin(), pieces.end(), WP)
+        || std::count(pieces.begin(), pieces.end(), BP);
+}
+
+std::vector<std::pair<int, int>> Material::groups() const {
+    std::vector<std::pair<int, int>> result;
+    for (int piece: pieces) {
+        if (piece == WK || piece == BK)
+            continue;
+        if (!result.empty() && result.back().first == piece)
+            result.back().second++;
+        else
+            result.push_back({piece, 1});
+    }
+    return result;
+}
+
+ull Material::size() const {
+    ull size = 2 * KINGS.squares[has_pawns()].size();
+    for (const auto& [piece, count]: groups())
+        size *= BINOMIAL[square_count(piece)][count];
+    return size;
+}
+
+ull Material::index(const Position& pos) const {
+    // Symmetry that brings the kings to a canonical pair.
+    const bool pawns = has_pawns();
+    const int wk = Bit::lsb(pos.wk), bk = Bit::lsb(pos.bk);
+    int t = (wk % 8 >= 4) ? MIRROR_FILE : 0;
+    if (!pawns) {
+        if (wk / 8 >= 4)
+            t |= MIRROR_RANK;
+        const int w = transform(wk, t), b = transform(bk, t);
+        if (w / 8 > w % 8 || (w / 8 == w % 8 && b / 8 > b % 8))
+            t |= MIRROR_DIAG;
+    }
+
+    ull index = pos.turn * KINGS.squares[pawns].size()
+        + KINGS.index[pawns][transform(wk, t)][transform(bk, t)];
+
+    // Like pieces are a set of squares: sorted, s1 < s2 < ..., it is sum of C(s_i, i).
+    for (const auto& [piece, count]: groups()) {
+        const int offset = square_count(piece) == 48 ? 8 : 0;
+        int squares[MAX_PIECES];
+        ull b = board(pos, piece);
+        // Insertion sort: there are only a few.
+        for (int i = 0; i < count; i++) {
+            const int sq = transform(Bit::pop_lsb(b), t) - offset;
+            int j = i;
+            for (; j > 0 && squares[j - 1] > sq; j--)
+                squares[j] = squares[j - 1];
+            squares[j] = sq;
+        }
+
+        ull sub = 0;
+        for (int i = 0; i < count; i++)
+            sub += BINOMIAL[squares[i]][i + 1];
+        index = index * BINOMIAL[square_count(piece)][count] + sub;
+    }
+    return index;
+}
+
+bool Material::position(ull index, Position& r_pos) const {
+    const bool pawns = has_pawns();
+    const std::vector<std::pair<int, int>> groups = this->groups();
+    r_pos.setup_empty();
+    ull occupied = 0;
+
+    // Groups were added last, so come off the index first.
+    for (int g = groups.size() - 1; g >= 0; g--) {
+        const auto [piece, count] = groups[g];
+        const int offset = square_count(piece) == 48 ? 8 : 0;
+        const ull combinations = BINOMIAL[square_count(piece)][count];
+        ull sub = index % combinations;
+        index /= combinations;
+
+        ull& b = board(r_pos, piece);
+        int s = square_count(piece) - 1;
+        for (int i = count; i >= 1; i--) {
+            while (BINOMIAL[s][i] > sub)
+                s--;
+            sub -= BINOMIAL[s][i];
+            const int sq = s + offset;
+            if (Bit::get(occupied, sq))
+                return false;
+            occupied = Bit::set(occupied, sq);
+            b = Bit::set(b, sq);
+            s--;
+        }
+    }
+
+    const int pairs = KINGS.squares[pawns].size();
+    const auto [wk, bk] = KINGS.squares[pawns][index % pairs];
+    if (Bit::get(occupied, wk) || Bit::get(occupied, bk))
+        return false;
+    r_pos.wk = Bit::mask(wk);
+    r_pos.bk = Bit::mask(bk);
+    r_pos.turn = index / pairs;
+    r_pos.ep = -1;
+    r_pos.move = 1;
+    r_pos.refresh_eval();
+    return true;
+}
+
+std::vector<Material> Material::successors() const {
+    std::vector<Material> result;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        const int piece = pieces[i];
+        if (piece == WK || piece == BK)
+            continue;
+
+        // Captured.
+        Material m;
+        m.pieces = pieces;
+        m.pieces.erase(m.pieces.begin() + i);
+        result.push_back(m);
+
+        // Promoted.
+        if (piece == WP || piece == BP) {
+            for (int promo = 0; promo < 4; promo++) {
+                m.pieces = pieces;
+                m.pieces[i] = piece == WP ? WHITE_CODES[promo] : BLACK_CODES[promo];
+                result.push_back(m);
+            }
+        }
+    }
+
+    for (Material& m: result)
+        m.canonicalize();
+    std::sort(result.begin(), result.end(), [](const Material& a, const Material& b) {
+        return a.key() < b.key();
+    });
+    auto same = [](const Material& a, const Material& b) {
+        return a.key() == b.key();
+    };
+    result.erase(std::unique(result.begin(), result.end(), same), result.end());
+    return result;
+}
+
+
+uint32_t key(const Position& pos) {
+    uint32_t key = 0;
+    for (int i = 0; i < 5; i++) {
+        key += Bit::popcnt(board(pos, WHITE_CODES[i])) << key_shift(WHITE_CODES[i]);
+        key += Bit::popcnt(board(pos, BLACK_CODES[i])) << key_shift(BLACK_CODES[i]);
+    }
+    return key;
+}
+
+/**
+ * Key with white and black counts swapped.
+ */
+static inline uint32_t flip_key(uint32_t key) {
+    constexpr uint32_t half = (1 << 15) - 1;
+    return (key >> 15) | ((key & half) << 15);
+}
+
+Position flip(const Position& pos) {
+    Position r = pos;
+    r.wp = __builtin_bswap64(pos.bp);
+    r.wn = __builtin_bswap64(pos.bn);
+    r.wb = __builtin_bswap64(pos.bb);
+    r.wr = __builtin_bswap64(pos.br);
+    r.wq = __builtin_bswap64(pos.bq);
+    r.wk = __builtin_bswap64(pos.bk);
+    r.bp = __builtin_bswap64(pos.wp);
+    r.bn = __builtin_bswap64(pos.wn);
+    r.bb = __builtin_bswap64(pos.wb);
+    r.br = __builtin_bswap64(pos.wr);
+    r.bq = __builtin_bswap64(pos.wq);
+    r.bk = __builtin_bswap64(pos.wk);
+    r.turn = !pos.turn;
+    r.castling = 0;
+    r.ep = pos.ep == -1 ? -1 : pos.ep ^ 56;
+    r.refresh_eval();
+    return r;
+}
+
+
+/**
+ * Whether header piece codes are a material in table order (see Material).
+ */
+static bool valid_pieces(const uint8_t* codes, int count) {
+    if (codes[0] != WK)
+        return false;
+    std::string name = "K";
+    bool black = false;
+    for (int i = 1; i < count; i++) {
+        const int piece = codes[i];
+        if (piece == BK && !black) {
+            black = true;
+            name += "vK";
+        } else if (black ? BP <= piece && piece <= BQ : WP <= piece && piece <= WQ) {
+            name += letter(piece);
+        } else {
+            return false;
+        }
+    }
+    return black && Material(name).pieces == std::vector<int>(codes, codes + count);
+}
+
+/**
+ * Whether the offsets are ordered and end at data_size, and each block's runs decode
+ * to exactly its values within its bytes, so value() never reads past them.
+ */
+static bool valid_blocks(const Table& table, size_t data_size) {
+    const ull size = table.material.size();
+    const ull blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (table.offsets[0] != 0 || table.offsets[blocks] != data_size)
+        return false;
+
+    for (ull block = 0; block < blocks; block++) {
+        if (table.offsets[block] > table.offsets[block+1])
+            return false;
+        const uint8_t* p = table.data + table.offsets[block];
+        const uint8_t* end = table.data + table.offsets[block+1];
+        ull remaining = std::min(BLOCK_SIZE, size - block * BLOCK_SIZE);
+        while (remaining > 0) {
+            if (p == end)
+                return false;
+            p++;
+            ull length = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (p == end || shift >= 64)
+                    return false;
+                const uint8_t byte = *p++;
+                length |= (ull)(byte & 127) << shift;
+                if (!(byte & 128))
+                    break;
+            }
+            if (length == 0 || length > remaining)
+                return false;
+            remaining -= length;
+        }
+        if (p != end)
+            return false;
+    }
+    return true;
+}
+
+uint8_t Table::value(ull index) const {
+    const uint8_t* p = data + offsets[index / BLOCK_SIZE];
+    ull remaining = index % BLOCK_SIZE;
+    while (true) {
+        const uint8_t value = *p++;
+        ull length = 0;
+        for (int shift = 0; ; shift += 7) {
+            const uint8_t byte = *p++;
+            length |= (ull)(byte & 127) << shift;
+            if (!(byte & 128))
+                break;
+        }
+        if (remaining < length)
+            return value;
+        remaining -= length;
+    }
+}
+
+void compress(const std::vector<uint8_t>& values, std::vector<uint64_t>& r_offsets,
+        std::vector<uint8_t>& r_data) {
+    r_offsets.clear();
+    r_data.clear();
+    uint8_t prev = VALUE_DRAW;
+    for (ull begin = 0; begin < values.size(); begin += BLOCK_SIZE) {
+        r_offsets.push_back(r_data.size());
+        const ull end = std::min(begin + BLOCK_SIZE, (ull)values.size());
+        for (ull i = begin; i < end; ) {
+            const uint8_t value = values[i] == VALUE_ILLEGAL ? prev : values[i];
+            ull length = 0;
+            while (i < end && (values[i] == value || values[i] == VALUE_ILLEGAL)) {
+                length++;
+                i++;
+            }
+            r_data.push_back(value);
+            do {
+                r_data.push_back((length & 127) | (length >= 128 ? 128 : 0));
+                length >>= 7;
+            } while (length > 0);
+            prev = value;
+        }
+    }
+    r_offsets.push_back(r_data.size());
+}
+
+
+const Table* find_table(uint32_t key) {
+    for (const Table& table: tables)
+        if (table.key == key)
+            return &table;
+    return nullptr;
+}
+
+bool load(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const uint8_t* header = (const uint8_t*)map;
+    const int num_pieces = header[5];
+    bool valid = std::memcmp(header, MAGIC, 4) == 0 && header[4] == VERSION
+        && 2 <= num_pieces && num_pieces <= MAX_PIECES;
+
+    Table table {Material("KvK"), 0, 0, header[6], nullptr, nullptr, map, (size_t)st.st_size};
+    valid = valid && valid_pieces(header + 8, num_pieces);
+    if (valid) {
+        table.material.pieces.assign(header + 8, header + 8 + num_pieces);
+        table.key = table.material.key();
+        table.flipped_key = flip_key(table.key);
+
+        // Offsets must fit before the data, which must decode within the file.
+        const ull blocks = (table.material.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        const size_t data_start = HEADER_SIZE + (blocks + 1) * sizeof(uint64_t);
+        table.offsets = (const uint64_t*)(header + HEADER_SIZE);
+        table.data = header + data_start;
+        valid = data_start <= (size_t)st.st_size
+            && valid_blocks(table, st.st_size - data_start);
+    }
+    if (!valid) {
+        std::cerr << "sftb:load: Invalid table file: " << path << std::endl;
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    // Replace table of same material.
+    for (Table& t: tables) {
+        if (t.key == table.key) {
+            munmap(t.map, t.map_size);
+            t = table;
+            return true;
+        }
+    }
+    tables.push_back(table);
+    loaded_max_pieces = std::max(loaded_max_pieces, num_pieces);
+    return true;
+}
+
+int init(const std::string& dir) {
+    for (Table& table: tables)
+        munmap(table.map, table.map_size);
+    tables.clear();
+    loaded_max_pieces = 0;
+
+    std::error_code ec;
+    int count = 0;
+    for (const auto& entry: std::filesystem::directory_iterator(dir, ec))
+        if (entry.path().extension() == EXTENSION && load(entry.path().string()))
+            count++;
+    return count;
+}
+
+int max_pieces() {
+    return loaded_max_pieces;
+}
+
+/**
+ * Look up pos in the tables, ignoring en passant rights.
+ */
+static bool probe_table(const Position& pos, Result& r_result) {
+    const uint32_t k = key(pos);
+    if (k == 0) {
+        r_result = {0, 0};
+        return true;
+    }
+
+    // Not in any table's king pairs.
+    if (kings_touch(Bit::lsb(pos.wk), Bit::lsb(pos.bk)))
+        return false;
+
+    for (const Table& table: tables) {
+        if (table.key != k && table.flipped_key != k)
+            continue;
+        // Symmetric material (e.g. KRvKR) is stored for both colors.
+        const ull index = table.key == k ? table.material.index(pos)
+            : table.material.index(flip(pos));
+        r_result = decode(table.value(index));
+        return true;
+    }
+    return false;
+}
+
+int probe_ep(const Position& pos, Result& r_best, bool& r_others) {
+    // Move generation takes a mutable position.
+    Position copy = pos;
+    Movegen::MoveList moves;
+    ull attacks;
+    Movegen::get_legal_moves(copy, moves, attacks);
+
+    int count = 0;
+    r_others = false;
+    for (const Move& move: moves) {
+        if (move.to != pos.ep || !Bit::get(pos.wp | pos.bp, move.from)) {
+            r_others = true;
+            continue;
+        }
+        Position child = pos;
+        child.push(move);
+        Result result;
+        if (!probe_table(child, result))
+            return -1;
+
+        // Child result is relative to the opponent.
+        const Result mine = {-result.wdl, result.wdl == 0 ? 0 : result.dtm + 1};
+        if (count++ == 0 || better(mine, r_best))
+            r_best = mine;
+    }
+    return count;
+}
+
+bool probe(const Position& pos, Result& r_result) {
+    if (pos.castling != 0)
+        return false;
+
+    // The table value covers every move but en passant captures.
+    if (pos.ep != -1) {
+        Result ep;
+        bool others;
+        const int count = probe_ep(pos, ep, others);
+        if (count < 0)
+            return false;
+        if (count > 0 && !others) {
+            r_result = ep;
+            return true;
+        }
+        if (count > 0) {
+            if (!probe_table(pos, r_result))
+                return false;
+            if (better(ep, r_result))
+                r_result = ep;
+            return true;
+        }
+    }
+    return probe_table(pos, r_result);
+}
+
+
+}
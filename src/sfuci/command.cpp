@@ -1,9 +1,26 @@
+#include <cstdint>
 #include <sstream>
+#include <stdexcept>
 
 #include "sfuci.hpp"
 #include "sfutils.hpp"
 
 
+/**
+ * Parse integer arg value.
+ * @return  false if value is not an integer.
+ */
+static inline bool parse_arg(const std::string& value, long long& r_value) {
+    try {
+        size_t end;
+        r_value = std::stoll(value, &end);
+        return end == value.size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+
 UCICommand::UCICommand(std::istream& is) {
     std::string line;
     if (!std::getline(is, line))
@@ -34,17 +51,49 @@ UCICommand::UCICommand(std::istream& is) {
         if (std::getline(iss, word, ' ') && word == "moves") {
             while (std::getline(iss, word, ' ')) {
                 const Move m(word);
+                history.push_back(pos);
                 pos.push(m);
             }
         }
+    } else if (mode == "setoption") {
+        // setoption name <name> [value <value>], both may contain spaces.
+        std::string* target = nullptr;
+        while (std::getline(iss, word, ' ')) {
+            if (word == "name") {
+                target = &name;
+            } else if (word == "value") {
+                target = &value;
+            } else if (target != nullptr) {
+                if (!target->empty())
+                    *target += " ";
+                *target += word;
+            }
+        }
+    } else if (mode == "bench") {
+        // Positional: bench [depth] [threads] [hash]. Invalid ones keep their default.
+        const char* names[] = {"depth", "threads", "hash"};
+        for (const char* name: names) {
+            if (!std::getline(iss, word, ' '))
+                break;
+            long long x;
+            if (parse_arg(word, x) && 0 < x && x <= INT32_MAX)
+                args[name] = x;
+        }
     } else {
         // Other args.
         while (std::getline(iss, word, ' ')) {
+            // Flags without value.
+            if (word == "infinite" || word == "ponder") {
+                args[word] = 1;
+                continue;
+            }
+
             std::string word2;
-            if (std::getline(iss, word2, ' ')) {
-                args[word] = std::stoi(word2);
-            } else {
+            long long x;
+            if (!std::getline(iss, word2, ' ')) {
                 args[word] = 1;
+            } else if (parse_arg(word2, x)) {
+                args[word] = x;
             }
         }
     }
@@ -1,6 +1,18 @@
+#include <iostream>
+#include <mutex>
+
 #include "sfuci.hpp"
 
 
+static std::mutex output_mutex;
+
+
+void uci_send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << line << std::endl;
+}
+
+
 std::string SearchResult::uci() {
     std::string str = "info ";
     for (const auto& [key, value]: data) {
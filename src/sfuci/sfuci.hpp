@@ -2,6 +2,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "sfutils.hpp"
 
@@ -23,14 +24,28 @@ public:
 
 
 /**
- * Has base (first word, e.g. "position"), and map of key to int value, e.g. movetime 1000.
+ * Print a line to stdout.
+ * Safe to call from the search thread while the main thread also prints.
+ */
+void uci_send(const std::string& line);
+
+
+/**
+ * Has base (first word, e.g. "position"), and map of key to integer value, e.g. movetime 1000.
+ * Values that aren't integers are skipped.
  * Also "Position" attr, only set if it's a position command.
+ * Also "history" attr: positions before each move of the position command, oldest first.
+ * Also "name" and "value" attrs, only set if it's a setoption command.
+ * bench args are positional: bench [depth] [threads] [hash].
  */
 class UCICommand {
 public:
     std::string mode;
-    std::map<std::string, int> args;
+    // 64 bit, for node counts.
+    std::map<std::string, long long> args;
     Position pos;
+    std::vector<Position> history;
+    std::string name, value;
 
     UCICommand(std::istream& is);
 };
@@ -0,0 +1,81 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloc.hpp"
+
+
+namespace Alloc {
+
+
+#ifdef SF_ALLOC_STATS
+
+// Trivial type, so usable before the thread's other thread_locals are constructed.
+static thread_local Counts thread_counts;
+
+Counts counts() {
+    return thread_counts;
+}
+
+static inline void* counted_alloc(std::size_t size) {
+    thread_counts.allocs++;
+    thread_counts.bytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static inline void counted_free(void* ptr) {
+    if (ptr == nullptr)
+        return;
+    thread_counts.frees++;
+    std::free(ptr);
+}
+
+#else
+
+Counts counts() {
+    return Counts();
+}
+
+#endif
+
+
+}
+
+
+#ifdef SF_ALLOC_STATS
+
+void* operator new(std::size_t size) {
+    void* ptr = Alloc::counted_alloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return Alloc::counted_alloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return Alloc::counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    Alloc::counted_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Alloc::counted_free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    Alloc::counted_free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    Alloc::counted_free(ptr);
+}
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+
+/**
+ * Heap allocation accounting, only compiled in with -DALLOC_STATS=ON
+ * (defines SF_ALLOC_STATS). Global operator new and delete are replaced to count
+ * allocations per thread. Statements wrapped in ALLOC_STATS() compile to nothing otherwise.
+ */
+#ifdef SF_ALLOC_STATS
+#define ALLOC_STATS(...) __VA_ARGS__
+#else
+#define ALLOC_STATS(...)
+#endif
+
+
+namespace Alloc {
+    /**
+     * Totals of one thread since it started.
+     */
+    struct Counts {
+        unsigned long long allocs = 0, frees = 0, bytes = 0;
+    };
+
+    /**
+     * Counts of the calling thread (all zero without SF_ALLOC_STATS).
+     */
+    Counts counts();
+}
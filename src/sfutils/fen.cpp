@@ -77,12 +77,18 @@ void Position::setup_fen(std::string fen) {
         ep = -1;
 
     // 50 move rule
-    while ((ch = *it++) != ' ') {
-        moves50 = ch - '0';
+    moves50 = 0;
+    while (it != fen.end() && (ch = *it++) != ' ') {
+        moves50 = 10 * moves50 + (ch - '0');
     }
 
     // Fullmove number
-    move = *it - '0';
+    move = 0;
+    while (it != fen.end() && '0' <= *it && *it <= '9') {
+        move = 10 * move + (*it++ - '0');
+    }
+
+    refresh_eval();
 }
 
 
@@ -137,9 +143,9 @@ std::string Position::get_fen() const {
     fen += ' ';
 
     // Moves
-    fen += '0' + moves50;
+    fen += std::to_string(moves50);
     fen += ' ';
-    fen += '0' + move;
+    fen += std::to_string(move);
 
     return fen;
 }
@@ -0,0 +1,55 @@
+#include <iomanip>
+#include <mutex>
+
+#include "profile.hpp"
+
+
+namespace Profile {
+
+
+#ifdef SF_PROFILE
+static const char* NAMES[SECTION_COUNT] = {
+    "get_legal_moves",
+    "board_info",
+    "Position::push",
+    "TPTable::hash",
+    "TPTable::get",
+    "TPTable::set",
+    "Eval::eval",
+};
+#endif
+
+static Counter last[SECTION_COUNT];
+static std::mutex last_mutex;
+
+
+void reset() {
+    for (Counter& counter: counters)
+        counter = Counter();
+}
+
+void publish() {
+    std::lock_guard<std::mutex> lock(last_mutex);
+    for (int i = 0; i < SECTION_COUNT; i++)
+        last[i] = counters[i];
+}
+
+void print(std::ostream& os) {
+#ifdef SF_PROFILE
+    std::lock_guard<std::mutex> lock(last_mutex);
+    os << std::left << std::setw(18) << "section" << std::right
+        << std::setw(14) << "calls" << std::setw(18) << "cycles" << std::setw(10) << "mean\n";
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        const Counter& c = last[i];
+        os << std::left << std::setw(18) << NAMES[i] << std::right
+            << std::setw(14) << c.calls << std::setw(18) << c.cycles
+            << std::setw(10) << (c.calls == 0 ? 0 : c.cycles / c.calls) << "\n";
+    }
+    os << std::flush;
+#else
+    os << "Profiling not compiled in, build with -DPROFILE=ON" << std::endl;
+#endif
+}
+
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+/**
+ * Hot path cycle profiler, only compiled in with -DPROFILE=ON (defines SF_PROFILE).
+ * PROFILE_SCOPE(section) times the rest of the enclosing block into a per-thread
+ * counter; without SF_PROFILE it compiles to nothing.
+ * Times are inclusive: get_legal_moves includes its board_info call.
+ */
+#ifdef SF_PROFILE
+#define PROFILE_SCOPE(section) Profile::ScopedTimer profile_timer_(Profile::section)
+#else
+#define PROFILE_SCOPE(section)
+#endif
+
+
+namespace Profile {
+    enum Section {
+        MOVEGEN,
+        BOARD_INFO,
+        PUSH,
+        TT_HASH,
+        TT_GET,
+        TT_SET,
+        EVAL,
+        SECTION_COUNT
+    };
+
+    struct Counter {
+        unsigned long long calls = 0, cycles = 0;
+    };
+
+    // Counters of the calling thread.
+    inline thread_local Counter counters[SECTION_COUNT];
+
+    /**
+     * Timestamp counter, or nanoseconds where rdtsc isn't available.
+     */
+    inline unsigned long long now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    class ScopedTimer {
+    public:
+        ScopedTimer(Section section) {
+            this->section = section;
+            start = now();
+        }
+
+        ~ScopedTimer() {
+            Counter& counter = counters[section];
+            counter.calls++;
+            counter.cycles += now() - start;
+        }
+
+    private:
+        Section section;
+        unsigned long long start;
+    };
+
+    /**
+     * Zero the calling thread's counters, e.g. at search start.
+     */
+    void reset();
+
+    /**
+     * Save the calling thread's counters as the last search's, for print().
+     */
+    void publish();
+
+    /**
+     * Print calls, total and mean cycles of each section of the last published counters.
+     */
+    void print(std::ostream& os);
+}
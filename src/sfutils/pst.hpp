@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+
+
+/**
+ * Piece square tables, shared by Position (which keeps a running sum of them,
+ * see Position::psq) and Eval. Also the pawn hash keys, kept the same way.
+ */
+namespace PST {
+    // Piece maps generated by copilot
+    constexpr int MAP_PAWN[64] = {
+        0,  0,  0,  0,  0,  0,  0,  0,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        10, 10, 20, 30, 30, 20, 10, 10,
+        5,  5, 10, 25, 25, 10,  5,  5,
+        0,  0,  0, 20, 20,  0,  0,  0,
+        5, -5,-10,  0,  0,-10, -5,  5,
+        5, 10, 10,-20,-20, 10, 10,  5,
+        0,  0,  0,  0,  0,  0,  0,  0
+    };
+    constexpr int MAP_KNIGHT[64] = {
+        -50,-40,-30,-30,-30,-30,-40,-50,
+        -40,-20,  0,  0,  0,  0,-20,-40,
+        -30,  0, 10, 15, 15, 10,  0,-30,
+        -30,  5, 15, 20, 20, 15,  5,-30,
+        -30,  0, 15, 20, 20, 15,  0,-30,
+        -30,  5, 10, 15, 15, 10,  5,-30,
+        -40,-20,  0,  5,  5,  0,-20,-40,
+        -50,-40,-30,-30,-30,-30,-40,-50
+    };
+    constexpr int MAP_BISHOP[64] = {
+        -20,-10,-10,-10,-10,-10,-10,-20,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -10,  0,  5, 10, 10,  5,  0,-10,
+        -10,  5,  5, 10, 10,  5,  5,-10,
+        -10,  0, 10, 10, 10, 10,  0,-10,
+        -10, 10, 10, 10, 10, 10, 10,-10,
+        -10,  5,  0,  0,  0,  0,  5,-10,
+        -20,-10,-10,-10,-10,-10,-10,-20
+    };
+    constexpr int MAP_ROOK[64] = {
+        0,  0,  0,  0,  0,  0,  0,  0,
+        5, 10, 10, 10, 10, 10, 10,  5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        0,  0,  0,  5,  5,  0,  0,  0
+    };
+    constexpr int MAP_QUEEN[64] = {
+        -20,-10,-10, -5, -5,-10,-10,-20,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -10,  0,  5,  5,  5,  5,  0,-10,
+         -5,  0,  5,  5,  5,  5,  0, -5,
+          0,  0,  5,  5,  5,  5,  0, -5,
+        -10,  5,  5,  5,  5,  5,  0,-10,
+        -10,  0,  5,  0,  0,  0,  0,-10,
+        -20,-10,-10, -5, -5,-10,-10,-20
+    };
+    constexpr int MAP_KING[64] = {
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -20,-30,-30,-40,-40,-30,-30,-20,
+        -10,-20,-20,-20,-20,-20,-20,-10,
+         20, 20,  0,  0,  0,  0, 20, 20,
+         20, 30, 10,  0,  0, 10, 30, 20
+    };
+    constexpr int MAP_KING_EG[64] = {
+        -50,-40,-30,-20,-20,-30,-40,-50,
+        -30,-20,-10,  0,  0,-10,-20,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-30,  0,  0,  0,  0,-30,-30,
+        -50,-30,-30,-30,-30,-30,-30,-50
+    };
+
+    /**
+     * Midgame and endgame values packed in one int, so both are summed with one add.
+     * The endgame half is in the upper 16 bits, offset by the sign of the lower half.
+     */
+    using Score = int;
+
+    constexpr Score make_score(int mg, int eg) {
+        return (int)((unsigned)eg << 16) + mg;
+    }
+
+    constexpr int mg_value(Score s) {
+        return (int16_t)(uint16_t)(unsigned)s;
+    }
+
+    constexpr int eg_value(Score s) {
+        return (int16_t)(uint16_t)((unsigned)(s + 0x8000) >> 16);
+    }
+
+    static_assert(mg_value(make_score(-7, 5) + make_score(3, -9)) == -4);
+    static_assert(eg_value(make_score(-7, 5) + make_score(3, -9)) == -4);
+
+    // Per piece type (pawn, knight, ..., king) material in centipawns,
+    // and weights of the maps in hundredths.
+    constexpr int VALUES[6] = {100, 300, 300, 500, 900, 0};
+    constexpr int WEIGHTS[6] = {52, 32, 36, 48, 52, 40};
+
+    // Game phase weight, indexed by piece code.
+    constexpr int PHASE[13] = {0, 1, 3, 3, 5, 9, 0, 1, 3, 3, 5, 9, 0};
+
+    /**
+     * Integer division rounding half away from zero.
+     */
+    constexpr int div_round(int a, int b) {
+        return a >= 0 ? (a + b/2) / b : -((-a + b/2) / b);
+    }
+
+    /**
+     * Fixed sequence of pseudo random numbers (splitmix64), usable at compile time.
+     */
+    constexpr unsigned long long splitmix64(unsigned long long& state) {
+        unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    struct Tables {
+        // Material plus weighted map, white positive, indexed by piece code and square.
+        Score scores[13][64];
+        // Zobrist keys of pawns only (other pieces are 0), for Position::pawn_key.
+        unsigned long long pawn_keys[13][64];
+    };
+
+    constexpr Tables build() {
+        const int* const MAPS[6] = {MAP_PAWN, MAP_KNIGHT, MAP_BISHOP, MAP_ROOK, MAP_QUEEN, MAP_KING};
+        Tables t {};
+        for (int type = 0; type < 6; type++) {
+            const int* map = MAPS[type];
+            const int* map_eg = type == 5 ? MAP_KING_EG : map;
+            for (int i = 0; i < 64; i++) {
+                // Maps are reversed for white.
+                const int w_mg = VALUES[type] + div_round(WEIGHTS[type] * map[63-i], 100);
+                const int w_eg = VALUES[type] + div_round(WEIGHTS[type] * map_eg[63-i], 100);
+                const int b_mg = VALUES[type] + div_round(WEIGHTS[type] * map[i], 100);
+                const int b_eg = VALUES[type] + div_round(WEIGHTS[type] * map_eg[i], 100);
+                t.scores[1+type][i] = make_score(w_mg, w_eg);
+                t.scores[7+type][i] = make_score(-b_mg, -b_eg);
+            }
+        }
+
+        unsigned long long state = 20240101;
+        for (int piece: {1, 7})
+            for (int i = 0; i < 64; i++)
+                t.pawn_keys[piece][i] = splitmix64(state);
+        return t;
+    }
+
+    constexpr Tables TABLES = build();
+}
@@ -4,6 +4,9 @@
 #include <iostream>
 #include <string>
 
+#include "profile.hpp"
+#include "pst.hpp"
+
 using uch = unsigned char;
 using ull = unsigned long long;
 
@@ -148,6 +151,31 @@ namespace Bit {
         }
         return -1;
     }
+
+    /**
+     * Index of least significant set bit.
+     * Undefined if b == 0.
+     */
+    inline int lsb(ull b) {
+        return __builtin_ctzll(b);
+    }
+
+    /**
+     * Index of most significant set bit.
+     * Undefined if b == 0.
+     */
+    inline int msb(ull b) {
+        return 63 - __builtin_clzll(b);
+    }
+
+    /**
+     * Returns least significant set bit and unsets it in b.
+     */
+    inline int pop_lsb(ull& b) {
+        const int i = lsb(b);
+        b &= b - 1;
+        return i;
+    }
 }
 
 
@@ -168,10 +196,10 @@ namespace Random {
 
 namespace Time {
     /**
-     * Milliseconds since epoch.
+     * Milliseconds on a monotonic clock (only differences are meaningful).
      */
     inline ull time() {
-        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
         const ull elapse = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
         return elapse;
     }
@@ -415,6 +443,11 @@ public:
     uch moves50;  // Fifty move rule.
     uch move;  // TODO this and above may have too small capacity.
 
+    // Running eval sums, kept up to date by push().
+    PST::Score psq;  // Material and piece maps, white minus black, see PST::TABLES.
+    int phase_material;  // Both sides, in pawns.
+    ull pawn_key;  // Hash of the pawns of both sides, see PST::Tables::pawn_keys.
+
     /**
      * NO initialization (may contain arbitrary values).
      * Use setup_std() to setup standard chess board.
@@ -443,6 +476,9 @@ public:
         ep = other.ep;
         moves50 = other.moves50;
         move = other.move;
+        psq = other.psq;
+        phase_material = other.phase_material;
+        pawn_key = other.pawn_key;
     }
 
     /**
@@ -455,6 +491,8 @@ public:
         ep = -1;
         moves50 = 0;
         move = 0;
+        psq = phase_material = 0;
+        pawn_key = 0;
     }
 
     /**
@@ -478,6 +516,7 @@ public:
         ep = -1;
         moves50 = 0;
         move = 1;
+        refresh_eval();
     }
 
     /**
@@ -572,6 +611,37 @@ public:
      */
     std::string get_fen() const;
 
+    /**
+     * Recompute the running eval sums from the bitboards.
+     * Needed after writing bitboards directly; setup_*() and push() do it themselves.
+     */
+    inline void refresh_eval() {
+        psq = phase_material = 0;
+        pawn_key = 0;
+        const ull* boards[13] = {nullptr, &wp, &wn, &wb, &wr, &wq, &wk, &bp, &bn, &bb, &br, &bq, &bk};
+        for (int piece = WP; piece <= BK; piece++) {
+            ull b = *boards[piece];
+            while (b)
+                eval_add(piece, Bit::pop_lsb(b));
+        }
+    }
+
+    /**
+     * Account for piece appearing on (or, eval_remove, leaving) square
+     * in the running eval sums. Bitboards are not touched.
+     */
+    inline void eval_add(int piece, int sq) {
+        psq += PST::TABLES.scores[piece][sq];
+        phase_material += PST::PHASE[piece];
+        pawn_key ^= PST::TABLES.pawn_keys[piece][sq];
+    }
+
+    inline void eval_remove(int piece, int sq) {
+        psq -= PST::TABLES.scores[piece][sq];
+        phase_material -= PST::PHASE[piece];
+        pawn_key ^= PST::TABLES.pawn_keys[piece][sq];
+    }
+
     /**
      * Doesn't clear other bbs first.
      * You can do that with set_at(sq, EMPTY); set_at(sq, your_choice);
@@ -614,46 +684,61 @@ public:
      * Otherwise, arbitrary behavior.
      */
     inline void push(const Move& m) {
-        // TODO update move50
+        PROFILE_SCOPE(PUSH);
+
+        // Pawn moves and captures reset the fifty move counter.
+        const int piece = piece_at(m.from);
+        const int captured = piece_at(m.to);
+        if (piece == WP || piece == BP || captured != EMPTY)
+            moves50 = 0;
+        else if (moves50 < 255)
+            moves50++;
 
         // Erase m.to on all bitboards (capture).
-        set_at(m.to, EMPTY);
+        if (captured != EMPTY) {
+            set_at(m.to, EMPTY);
+            eval_remove(captured, m.to);
+        }
 
         ull& board = piece_bb(m.from);
         board = Bit::unset(board, m.from);
+        eval_remove(piece, m.from);
         if (m.promo == Promo::NONE) {
             // Normal move
             board = Bit::set(board, m.to);
+            eval_add(piece, m.to);
         } else {
             // Promotion
-            if (turn) {
-                if (m.promo == Promo::KNIGHT) wn = Bit::set(wn, m.to);
-                else if (m.promo == Promo::BISHOP) wb = Bit::set(wb, m.to);
-                else if (m.promo == Promo::ROOK) wr = Bit::set(wr, m.to);
-                else if (m.promo == Promo::QUEEN) wq = Bit::set(wq, m.to);
-            } else {
-                if (m.promo == Promo::KNIGHT) bn = Bit::set(bn, m.to);
-                else if (m.promo == Promo::BISHOP) bb = Bit::set(bb, m.to);
-                else if (m.promo == Promo::ROOK) br = Bit::set(br, m.to);
-                else if (m.promo == Promo::QUEEN) bq = Bit::set(bq, m.to);
-            }
+            const int promoted = (turn ? WP : BP) + m.promo;
+            set_at(m.to, promoted);
+            eval_add(promoted, m.to);
         }
 
         // Castling.
         if (&board == &wk) {
             if (m.from == square(4, 0)) {
-                if (m.to == square(6, 0))
+                if (m.to == square(6, 0)) {
                     wr = Bit::set(Bit::unset(wr, square(7, 0)), square(5, 0));
-                else if (m.to == square(2, 0))
+                    eval_remove(WR, square(7, 0));
+                    eval_add(WR, square(5, 0));
+                } else if (m.to == square(2, 0)) {
                     wr = Bit::set(Bit::unset(wr, square(0, 0)), square(3, 0));
+                    eval_remove(WR, square(0, 0));
+                    eval_add(WR, square(3, 0));
+                }
             }
             castling &= ~CASTLE_W;
         } else if (&board == &bk) {
             if (m.from == square(4, 7)) {
-                if (m.to == square(6, 7))
+                if (m.to == square(6, 7)) {
                     br = Bit::set(Bit::unset(br, square(7, 7)), square(5, 7));
-                else if (m.to == square(2, 7))
+                    eval_remove(BR, square(7, 7));
+                    eval_add(BR, square(5, 7));
+                } else if (m.to == square(2, 7)) {
                     br = Bit::set(Bit::unset(br, square(0, 7)), square(3, 7));
+                    eval_remove(BR, square(0, 7));
+                    eval_add(BR, square(3, 7));
+                }
             }
             castling &= ~CASTLE_B;
         }
@@ -666,8 +751,10 @@ public:
         if ((&board == &wp || &board == &bp) && m.to == ep) {
             if (turn) {
                 bp = Bit::unset(bp, m.to - 8);
+                eval_remove(BP, m.to - 8);
             } else {
                 wp = Bit::unset(wp, m.to + 8);
+                eval_remove(WP, m.to + 8);
             }
         }
 
@@ -686,4 +773,17 @@ public:
         if (turn)
             move++;
     }
+
+    /**
+     * Pass the turn without moving (null move).
+     * Only used in search, the result is not a legal game position.
+     * Resets the fifty move counter, so repetitions are never detected across it.
+     */
+    inline void push_null() {
+        ep = -1;
+        moves50 = 0;
+        turn = !turn;
+        if (turn)
+            move++;
+    }
 };
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.hpp"
+#include "sftb.hpp"
+
+
+/**
+ * Parse a positive integer option value.
+ * @return  false if value is not an integer of at least 1.
+ */
+static bool parse_count(const std::string& value, int& r_count) {
+    try {
+        size_t end;
+        r_count = std::stoi(value, &end);
+        return end == value.size() && r_count >= 1;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+
+/**
+ * Generate endgame tablebases.
+ * Usage: swordfish_tbgen [-t threads] dir material...
+ * e.g. swordfish_tbgen tb KQvK KRvK KPvK KQvKR
+ */
+int main(int argc, char** argv) {
+    std::cerr << "Swordfish tablebase generator v" << VERSION_MAJOR << "." << VERSION_MINOR
+        << "." << VERSION_PATCH << std::endl;
+
+    int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::vector<std::string> args;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc)
+            valid &= parse_count(argv[++i], threads);
+        else
+            args.push_back(arg);
+    }
+    if (!valid || args.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " [-t threads] dir material...\n"
+            << "Material has at most " << Tablebase::MAX_PIECES << " pieces, e.g. KQvKR."
+            << " Smaller tables it needs are generated first." << std::endl;
+        return 1;
+    }
+
+    try {
+        for (size_t i = 1; i < args.size(); i++)
+            Tablebase::generate(args[0], args[i], threads);
+    } catch (int) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+#include "sfutils.hpp"
+#include "trace.hpp"
+
+using Search::TraceRecord;
+
+
+// Records read from the file at once.
+constexpr size_t CHUNK = 1 << 16;
+// Cutoff indices at or above this are counted together.
+constexpr int MAX_CUTOFF_INDEX = 10;
+
+const char* NODE_TYPES[4] = {"root", "pv", "nonpv", "qsearch"};
+
+
+/**
+ * A root move's part of one root search.
+ */
+struct RootMove {
+    uint16_t move;
+    ull nodes;
+    int score;
+};
+
+/**
+ * One search of the root (an iteration, or an aspiration or MultiPV re-search).
+ */
+struct RootSearch {
+    int depth;
+    int score;
+    ull nodes;
+    std::vector<RootMove> moves;
+    // Stopped before finishing, so score is not a result.
+    bool aborted;
+};
+
+
+static std::string move_str(uint16_t move) {
+    return Move(move & 63, (move >> 6) & 63, (move >> 12) & 7).uci();
+}
+
+static std::string percent(ull num, ull den) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%.1f%%", den == 0 ? 0.0 : 100.0 * num / den);
+    return buf;
+}
+
+
+/**
+ * Summarize a search tree trace written with the TraceFile option.
+ * Usage: swordfish_trace file
+ */
+int main(int argc, char** argv) {
+    std::cerr << "Swordfish trace viewer v" << VERSION_MAJOR << "." << VERSION_MINOR
+        << "." << VERSION_PATCH << std::endl;
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " file" << std::endl;
+        return 1;
+    }
+
+    FILE* fp = std::fopen(argv[1], "rb");
+    char magic[4];
+    if (fp == nullptr || std::fread(magic, 1, 4, fp) != 4
+            || std::memcmp(magic, Search::TRACE_MAGIC, 4) != 0) {
+        std::cerr << "Not a trace file: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    ull total = 0, tt_hits = 0, cutoffs = 0;
+    ull type_counts[4] = {};
+    ull cutoff_hist[MAX_CUTOFF_INDEX + 1] = {};
+    std::vector<RootSearch> root_searches;
+
+    // Records are in post-order: a root move's subtree is everything since the
+    // previous record at ply 0 or 1.
+    RootSearch current = {0, 0, 0, {}, false};
+    ull since_root_child = 0;
+
+    std::vector<TraceRecord> buffer(CHUNK);
+    size_t count;
+    while ((count = std::fread(buffer.data(), sizeof(TraceRecord), CHUNK, fp)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            const TraceRecord& r = buffer[i];
+            total++;
+            type_counts[std::min((int)r.node_type, 3)]++;
+            if (r.flags & Search::TRACE_TT_HIT)
+                tt_hits++;
+            if (r.flags & Search::TRACE_CUTOFF) {
+                cutoffs++;
+                cutoff_hist[std::min((int)r.cutoff_index, MAX_CUTOFF_INDEX)]++;
+            }
+
+            if (r.ply >= 2) {
+                since_root_child++;
+            } else if (r.ply == 1) {
+                // Null window searches and re-searches of a move are summed.
+                const ull nodes = since_root_child + 1;
+                auto it = std::find_if(current.moves.begin(), current.moves.end(),
+                    [&](const RootMove& m) { return m.move == r.move; });
+                if (it == current.moves.end())
+                    current.moves.push_back({r.move, nodes, -r.score});
+                else
+                    *it = {r.move, it->nodes + nodes, -r.score};
+                current.nodes += nodes;
+                since_root_child = 0;
+            } else {
+                current.depth = r.depth;
+                current.score = r.score;
+                current.aborted = r.flags & Search::TRACE_ABORTED;
+                current.nodes += since_root_child + 1;
+                root_searches.push_back(current);
+                current = {0, 0, 0, {}, false};
+                since_root_child = 0;
+            }
+        }
+    }
+    std::fclose(fp);
+
+    std::cout << "Nodes: " << total << "\n";
+    for (int i = 0; i < 4; i++)
+        std::cout << "  " << NODE_TYPES[i] << ": " << type_counts[i] << " ("
+            << percent(type_counts[i], total) << ")\n";
+    std::cout << "TT hits: " << tt_hits << " (" << percent(tt_hits, total) << ")\n";
+
+    std::cout << "\nCutoffs: " << cutoffs << ", by index of cutoff move:\n";
+    for (int i = 1; i <= MAX_CUTOFF_INDEX; i++)
+        std::cout << "  " << (i == MAX_CUTOFF_INDEX ? std::to_string(i) + "+" : std::to_string(i))
+            << ": " << cutoff_hist[i] << " (" << percent(cutoff_hist[i], cutoffs) << ")\n";
+
+    std::cout << "\nRoot searches: " << root_searches.size() << "\n";
+    for (const RootSearch& rs: root_searches)
+        std::cout << "  depth " << rs.depth << ": " << rs.nodes << " nodes, "
+            << (rs.aborted ? "aborted" : "score " + std::to_string(rs.score)) << "\n";
+
+    if (!root_searches.empty()) {
+        RootSearch last = root_searches.back();
+        std::sort(last.moves.begin(), last.moves.end(), [](const RootMove& a, const RootMove& b) {
+            return a.nodes > b.nodes;
+        });
+        std::cout << "\nSubtree sizes of last root search (depth " << last.depth << "):\n";
+        for (const RootMove& m: last.moves)
+            std::cout << "  " << move_str(m.move) << ": " << m.nodes << " ("
+                << percent(m.nodes, last.nodes) << "), score " << m.score << "\n";
+    }
+    std::cout << std::flush;
+    return 0;
+}
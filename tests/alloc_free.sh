@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Checks that tree search doesn't allocate on the heap.
+# Needs a build with allocation counting: make ALLOC_STATS=ON
+
+set -e
+
+SWORDFISH=${SWORDFISH:-../build/swordfish}
+
+output=$(echo "bench ${1:-8}" | $SWORDFISH)
+echo "$output"
+
+line=$(echo "$output" | grep "Search tree allocations:" || true)
+if [ -z "$line" ]; then
+    echo "No allocation counts, build with: make ALLOC_STATS=ON"
+    exit 1
+fi
+if [ "$(echo "$line" | awk '{print $4}')" != "0" ]; then
+    echo "Search allocates: $line"
+    exit 1
+fi
+echo "OK: search is allocation free"
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Checks book keys against the Polyglot reference keys:
+# http://hgm.nubati.net/book_format.html
+
+set -e
+
+SWORDFISH=${SWORDFISH:-../build/swordfish}
+
+# Args: (moves from start position, expected key)
+function test_key() {
+    key=$(printf "position startpos moves $1\nd\nquit\n" | $SWORDFISH 2>/dev/null \
+        | grep "Book key:" | awk '{print $3}')
+    if [ "$key" != "$2" ]; then
+        echo "Wrong key after \"$1\": $key, expected $2"
+        exit 1
+    fi
+}
+
+test_key "" 463b96181691fc9c
+test_key "e2e4" 823c9b50fd114196
+test_key "e2e4 d7d5" 756b94461c50fb0
+test_key "e2e4 d7d5 e4e5" 662fafb965db29d4
+test_key "e2e4 d7d5 e4e5 f7f5" 22a48b5a8e47ff78
+test_key "e2e4 d7d5 e4e5 f7f5 e1e2" 652a607ca3f242c1
+test_key "e2e4 d7d5 e4e5 f7f5 e1e2 e8f7" fdd303c946bdd9
+test_key "a2a4 b7b5 h2h4 b5b4 c2c4" 3c8123ea7b067637
+test_key "a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3" 5c3f9b829b279560
+echo "OK: book keys match Polyglot"